@@ -28,6 +28,7 @@ struct BrushGlobals_s {
     uColor_s secondary_color;
     enum brushmodes mode;
     int shape;
+    int circle_radius;  // if > 0, a circle with this radius is used instead of shape
     bool shading_active;
     enum selectionmode selection_mode;
 };
@@ -42,6 +43,9 @@ bool brush_draw_pixel(int c, int r);
 
 bool brush_draw(int c, int r);
 
+// draws the brush at c, r after it was drawn at c - dc, r - dr (unit step), only the new cells
+bool brush_draw_step(int c, int r, int dc, int dr);
+
 void brush_abort_current_draw();
 
 void brush_set_selection_active(bool active, bool reset);
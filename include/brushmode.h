@@ -10,8 +10,6 @@ bool brushmode_dot(ePointer_s pointer);
 
 bool brushmode_free(ePointer_s pointer);
 
-bool brushmode_free_line(ePointer_s pointer);
-
 bool brushmode_fill(ePointer_s pointer, bool mode8);
 
 bool brushmode_replace(ePointer_s pointer);
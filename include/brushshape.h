@@ -7,6 +7,7 @@
 
 #define BRUSH_KERNEL_SIZE 7
 #define BRUSH_NUM_SHAPES 16
+#define BRUSH_MAX_CIRCLE_RADIUS 16
 
 #define BRUSH_KERNEL_TEXTURE_SIZE 8
 
@@ -19,8 +20,14 @@ extern struct BrushShapeGlobals_s brushshape;
 
 rTexture brushshape_create_kernel_texture(uColor_s bg, uColor_s fg);
 
+// draws the current shape (brush.shape or brush.circle_radius) centered at c, r
 bool brushshape_draw(int c, int r);
 
+// as brushshape_draw, but only on every second pixel (a selects the pattern)
 bool brushshape_draw_dither(int c, int r, bool a);
 
+// draws only the leading edge of the shape at c, r, after it was drawn at c - dc, r - dr (unit step)
+// the rest of the shape is already drawn, so a line costs O(length * width)
+bool brushshape_draw_step(int c, int r, int dc, int dr, bool dither, bool a);
+
 #endif //TILEC_BRUSHSHAPE_H
@@ -29,10 +29,32 @@ uImage canvas_image();
 
 ivec2 canvas_get_cr(vec4 pointer_pos);
 
+// marks a region of the image as changed (all layers),
+// only dirty regions are rebuild in canvas_update
+void canvas_mark_dirty(int left, int top, int cols, int rows);
+
+// increases once per canvas_update, in which the image has changed
+int canvas_generation();
+
+// region (all layers), that changed after the given generation
+// returns false if nothing changed
+bool canvas_changed_since(int generation, int *out_left, int *out_top, int *out_cols, int *out_rows);
+
 void canvas_clear();
 
+// saves a state and writes the changed chunks of the tilemap file in the background
 void canvas_save();
 
+// writes the png file (and the tilemap file) in the background.
+// Also done by canvas_update every minute while the image changes and by canvas_save_flush
+void canvas_export();
+
+// savestate generation of the loaded tilemap file, or 0 if loaded from the png
+uint64_t canvas_file_generation();
+
+// exports the png file, if outdated, and waits until the background writes are finished
+void canvas_save_flush();
+
 void canvas_redo_image();
 
 #endif //TILEC_CANVAS_H
@@ -6,6 +6,7 @@
 //
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "mathc/types/float.h"
 #include "core.h"
 
@@ -13,6 +14,10 @@
 #define E_MAX_POINTER_EVENTS 32
 #define E_MAX_WHEEL_EVENTS 32
 
+// moves are coalesced per frame, for up to E_MAX_POINTERS pointers
+#define E_MAX_POINTERS 10
+#define E_MAX_POINTER_SAMPLES 128
+
 // ePointer_s::id for middle and right button clicks
 #define E_POINTER_BUTTON_MIDDLE -1
 #define E_POINTER_BUTTON_RIGHT -2
@@ -45,6 +50,11 @@ typedef struct {
     int id;   // 0 = default; >0 multitouch; <0 m+r click
 } ePointer_s;
 
+typedef struct {
+    ePointer_s pointer;
+    uint32_t time;  // SDL ticks in ms
+} ePointerSample_s;
+
 typedef void (*ePointerEventFn)(ePointer_s, void *user_data);
 
 typedef void (*eWheelEventFn)(bool up, void *user_data);
@@ -53,8 +63,14 @@ typedef void (*eWheelEventFn)(bool up, void *user_data);
 void e_input_init();
 
 // runs the sdl event loop
+// all moves of a pointer are emitted as a single E_POINTER_MOVE with the last position
 void e_input_update();
 
+// only valid in a pointer event callback:
+// returns the samples of the current event in order, the last one is the event itself
+// an E_POINTER_MOVE may be coalesced from multiple samples
+const ePointerSample_s *e_input_pointer_history(int *out_size);
+
 // registers a callback for mouse and touch
 void e_input_register_pointer_event(ePointerEventFn event, void *user_data);
 
@@ -0,0 +1,36 @@
+#ifndef R_FRAMEBUFFER_H
+#define R_FRAMEBUFFER_H
+
+//
+// offscreen render target, to render into a texture
+//
+
+#include <stdbool.h>
+#include "core.h"
+#include "texture.h"
+
+typedef struct {
+    GLuint fbo;
+    rTexture tex;   // single sprite texture, holds premultiplied alpha colors
+} rFramebuffer;
+
+static bool r_framebuffer_valid(rFramebuffer self) {
+    return self.fbo > 0 && r_texture_valid(self.tex);
+}
+
+static rFramebuffer r_framebuffer_new_invalid() {
+    return (rFramebuffer) {0};
+}
+
+rFramebuffer r_framebuffer_new(int cols, int rows);
+
+void r_framebuffer_kill(rFramebuffer *self);
+
+// binds the framebuffer as render target and clears it.
+// blending is set up to accumulate premultiplied alpha colors
+void r_framebuffer_begin(rFramebuffer self);
+
+// restores the previous render target, viewport and blending
+void r_framebuffer_end();
+
+#endif //R_FRAMEBUFFER_H
@@ -31,6 +31,13 @@ GLuint r_program_new(const GLuint *shaders, int n, bool delete_shaders);
 // loads a program from a single file (only vertex and fragment shader)
 GLuint r_program_new_file(const char *file);
 
+// as r_program_new_file, but shared with all users of the same file (reference counted)
+// must be killed with r_program_kill_shared
+GLuint r_program_new_file_shared(const char *file);
+
+// releases a program of r_program_new_file_shared, the last one deletes it
+void r_program_kill_shared(GLuint program);
+
 // tests if a draw call is valid (heavy call)
 void r_program_validate(GLuint program);
 
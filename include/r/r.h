@@ -9,15 +9,19 @@
 #include "render.h"
 #include "texture.h"
 #include "texture2d.h"
+#include "framebuffer.h"
 #include "program.h"
+#include "stream.h"
 #include "rect.h"
 #include "ro_single.h"
 #include "ro_batch.h"
+#include "ro_batch2d.h"
 #include "ro_particle.h"
 #include "ro_text.h"
 #include "ro_ttftext.h"
 #include "ro_singlerefract.h"
 #include "ro_batchrefract.h"
 #include "ro_particlerefract.h"
+#include "ro_tilemap.h"
 
 #endif //R_R_H
@@ -7,6 +7,7 @@
 
 #include <stddef.h> // offsetof
 #include "mathc/types/float.h"
+#include "mathc/types/uchar.h"
 
 // basic rect for rendering
 typedef struct {
@@ -16,6 +17,21 @@ typedef struct {
     vec2 sprite;    // position of the sprite in the grid
 } rRect_s;
 
+// compact 2d rect (44 bytes instead of 168), used by ro_batch2d
+typedef struct {
+    vec2 xy;        // center position
+    vec2 size;      // width and height (negative to mirror)
+    vec2 uv_xy;     // uv offset (texture coord of the left top corner)
+    vec2 uv_size;   // uv scale
+    float angle;    // rotation around the center in radians
+    ucvec4 color;   // additional color as RGBA8 (texture_color * color)
+    struct {
+        unsigned short x, y;
+    } sprite;       // position of the sprite in the grid
+} rRect2d_s;
+
+_Static_assert(sizeof(rRect2d_s) == 11 * 4, "rRect2d_s must not be padded");
+
 // rect with additional values for a particle system
 typedef struct {
     union {
@@ -51,6 +67,16 @@ rRect_s r_rect_new();
 // as new, but xy=MAX, alpha=0
 rRect_s r_rect_new_hidden();
 
+// creates a new 2d rect with:
+// xy = 0, size = 1, angle = 0
+// uv_xy = 0, uv_size = 1
+// color = 255
+// sprite = 0
+rRect2d_s r_rect2d_new();
+
+// as new, but xy=MAX, alpha=0
+rRect2d_s r_rect2d_new_hidden();
+
 // creates a new particle rect with:
 // rect = rect_new
 // sprite_speed, speed, acc, color_speed = 0
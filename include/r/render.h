@@ -16,6 +16,10 @@ struct rRenderGolabals_s {
     
     // 3D (2D_ARRAY) not working in WebGL2
     rTexture2D framebuffer_tex;         // copy of the framebuffer, after blit_framebuffer
+
+    int max_texture_size;           // GL_MAX_TEXTURE_SIZE, set by init
+
+    int avoided_gl_calls;           // redundant gl calls skipped in the last frame
 };
 extern struct rRenderGolabals_s r_render;
 
@@ -29,6 +33,23 @@ void r_render_begin_frame(int cols, int rows);
 // swaps the framebuffer
 void r_render_end_frame();
 
+// if true, sets the blend function for premultiplied alpha colors (see r/framebuffer.h)
+// else, resets to the default blend function
+void r_render_blend_premultiplied(bool premultiplied);
+
+// cached state, the gl call is skipped, if the binding is already current
+void r_render_use_program(GLuint program);
+
+// cached state, the gl call is skipped, if the binding is already current
+void r_render_bind_vertex_array(GLuint vao);
+
+// cached state, binds the texture to GL_TEXTURE0 + unit and makes the unit active
+// the gl calls are skipped, if the binding is already current
+void r_render_bind_texture(int unit, GLenum target, GLuint tex);
+
+// forgets the cached state, needed after direct gl calls, or deleting a bound object
+void r_render_invalidate_state();
+
 // copies the current framebuffer into r_render.framebuffer_tex
 // cols and rows of the current screen, see e_window
 void r_render_blit_framebuffer(int cols, int rows);
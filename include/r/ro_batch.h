@@ -9,6 +9,7 @@
 #include "core.h"
 #include "rect.h"
 #include "texture.h"
+#include "stream.h"
 
 typedef struct {
     rRect_s *rects;
@@ -18,9 +19,12 @@ typedef struct {
 
     struct {
         GLuint program;     // shader
+        GLint loc_vp, loc_sprites;  // uniform locations
         GLuint vao;         // internal vertex array object
         GLuint vbo;         // internal vertex buffer object
         rTexture tex;       // used texture
+        bool streaming;     // if true, uses the stream instead of vao and vbo
+        rStream stream;
         Allocator_s allocator;
     } L;
 } RoBatch;
@@ -43,6 +47,11 @@ void ro_batch_render_sub(RoBatch *self, int num);
 // resets the texture, if .owns_tex is true, it will delete the old texture
 void ro_batch_set_texture(RoBatch *self, rTexture tex_sink);
 
+// for batches that are updated each frame:
+// uploads into a ring of buffers, so the cpu does not wait for the gpu (see r/stream.h).
+// an update copies the changed range into the next buffer, together with the ranges it missed
+void ro_batch_set_streaming(RoBatch *self, bool streaming);
+
 
 static void ro_batch_update(RoBatch *self) {
     ro_batch_update_sub(self, 0, self->num);
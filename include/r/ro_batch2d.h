@@ -0,0 +1,66 @@
+#ifndef R_RO_BATCH2D_H
+#define R_RO_BATCH2D_H
+
+//
+// class to render multiple 2d rects with a single draw call.
+// like ro_batch, but with the compact rRect2d_s instances
+//
+
+#include "rhc/allocator.h"
+#include "core.h"
+#include "rect.h"
+#include "texture.h"
+#include "stream.h"
+
+typedef struct {
+    rRect2d_s *rects;
+    int num;
+    const float *vp;    // mat4 camera view perspective
+    bool owns_tex;      // if true, the texture will be deleted by this class
+
+    struct {
+        GLuint program;     // shader
+        GLint loc_vp, loc_sprites;  // uniform locations
+        GLuint vao;         // internal vertex array object
+        GLuint vbo;         // internal vertex buffer object
+        rTexture tex;       // used texture
+        bool streaming;     // if true, uses the stream instead of vao and vbo
+        rStream stream;
+        Allocator_s allocator;
+    } L;
+} RoBatch2d;
+
+RoBatch2d ro_batch2d_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s alloc);
+
+static RoBatch2d ro_batch2d_new(int num, const float *vp, rTexture tex_sink) {
+    return ro_batch2d_new_a(num, vp, tex_sink, allocator_new_default());
+}
+
+
+void ro_batch2d_kill(RoBatch2d *self);
+
+// updates a subset of the batch into the gpu
+void ro_batch2d_update_sub(RoBatch2d *self, int offset, int size);
+
+// renders a subset of the batch
+void ro_batch2d_render_sub(RoBatch2d *self, int num);
+
+// resets the texture, if .owns_tex is true, it will delete the old texture
+void ro_batch2d_set_texture(RoBatch2d *self, rTexture tex_sink);
+
+// for batches that are updated each frame:
+// uploads into a ring of buffers, so the cpu does not wait for the gpu (see r/stream.h).
+// an update copies the changed range into the next buffer, together with the ranges it missed
+void ro_batch2d_set_streaming(RoBatch2d *self, bool streaming);
+
+
+static void ro_batch2d_update(RoBatch2d *self) {
+    ro_batch2d_update_sub(self, 0, self->num);
+}
+
+static void ro_batch2d_render(RoBatch2d *self) {
+    ro_batch2d_render_sub(self, self->num);
+}
+
+
+#endif //R_RO_BATCH2D_H
@@ -10,6 +10,7 @@
 #include "core.h"
 #include "rect.h"
 #include "texture.h"
+#include "stream.h"
 
 typedef struct {
     rParticleRect_s *rects;
@@ -19,9 +20,12 @@ typedef struct {
 
     struct {
         GLuint program;     // shader
+        GLint loc_vp, loc_sprites, loc_time;  // uniform locations
         GLuint vao;         // internal vertex array object
         GLuint vbo;         // internal vertex buffer object
         rTexture tex;       // used texture
+        bool streaming;     // if true, uses the stream instead of vao and vbo
+        rStream stream;
         Allocator_s allocator;
     } L;
 } RoParticle;
@@ -44,6 +48,11 @@ void ro_particle_render_sub(RoParticle *self, float time, int num);
 // resets the texture, if .owns_tex is true, it will delete the old texture
 void ro_particle_set_texture(RoParticle *self, rTexture tex_sink);
 
+// for particles that are updated each frame:
+// uploads into a ring of buffers, so the cpu does not wait for the gpu (see r/stream.h).
+// an update copies the changed range into the next buffer, together with the ranges it missed
+void ro_particle_set_streaming(RoParticle *self, bool streaming);
+
 static void ro_particle_update(RoParticle *self) {
     ro_particle_update_sub(self, 0, self->num);
 }
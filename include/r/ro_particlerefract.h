@@ -42,6 +42,7 @@ typedef struct {
 
     struct {
         GLuint program;                     // shader
+        GLint loc_vp, loc_sprites, loc_time, loc_scale, loc_view_aabb;  // uniform locations
         GLuint vao;                         // internal vertex array object
         GLuint vbo;                         // internal vertex buffer object
         rTexture tex_main;                  // used main texture
@@ -18,6 +18,7 @@ typedef struct {
 
     struct {
         GLuint program;     // shader
+        GLint loc_pose, loc_uv, loc_color, loc_sprite, loc_vp, loc_sprites;  // uniform locations
         GLuint vao;         // internal vertex array object
         rTexture tex;       // used texture
     } L;
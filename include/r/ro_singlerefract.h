@@ -40,6 +40,7 @@ typedef struct {
 
     struct {
         GLuint program;                         // shader
+        GLint loc_pose, loc_uv, loc_color, loc_sprite, loc_vp, loc_sprites, loc_scale, loc_view_aabb;  // uniform locations
         GLuint vao;                             // internal vertex array object
         rTexture tex_main;                      // used main texture
         rTexture tex_refraction;                // used refraction texture
@@ -6,13 +6,13 @@
 // based on a font sprite sheet and is monospaced.
 //
 
-#include "ro_batch.h"
+#include "ro_batch2d.h"
 
 // return true for a newline
 typedef bool (*ro_text_sprite_fn)(vec2 *sprite, char c);
 
 typedef struct {
-    RoBatch ro;             // internal batch to render
+    RoBatch2d ro;           // internal batch to render
     ro_text_sprite_fn sprite_fn;    // conversion function of character to sprite mapping
     mat4 pose;              // pose (top left) for the text
     vec2 size;              // character size
@@ -0,0 +1,56 @@
+#ifndef R_RO_TILEMAP_H
+#define R_RO_TILEMAP_H
+
+//
+// class to render a tilemap with a single draw call.
+// the map is stored on the gpu as color coded texture (see README.md):
+//     b = sheet id (1 based, 0 = empty), a = tile index in that sheet (row major)
+// the tiles texture needs a sheet per layer (sprites = {1, sheets}),
+// or a layer (slot) for each sheet in .slots
+//
+
+#define RO_TILEMAP_MAX_SHEETS 128   // as in tilemap.glsl
+
+#include <stdbool.h>
+#include "mathc/types/int.h"
+#include "core.h"
+#include "texture.h"
+
+typedef struct {
+    mat4 pose;          // 3d pose for the whole map (see u/pose.h)
+    mat4 uv;            // 3d pose for the map coordinates, eye = full map (see u/pose.h)
+    vec4 color;         // additional color (tile_color * color)
+    const float *vp;    // mat4 camera view perspective
+    const int *slots;   // optional int[RO_TILEMAP_MAX_SHEETS], texture layer of each sheet (id - 1), < 0 if not loaded
+    bool owns_tex;      // if true, the tiles texture will be deleted by this class
+
+    struct {
+        GLuint program;     // shader
+        GLint loc_pose, loc_uv, loc_color, loc_vp, loc_map_size, loc_sheet_tiles, loc_sheets, loc_slots;  // uniform locations
+        GLuint vao;         // internal vertex array object
+        GLuint map;         // GL_TEXTURE_2D with the tile codes
+        ivec2 size;         // cols, rows of the map
+        ivec2 sheet_tiles;  // cols, rows of tiles in a sheet
+        rTexture tex;       // used tiles texture
+        int layers[RO_TILEMAP_MAX_SHEETS];  // slots without .slots: sheet id - 1
+    } L;
+} RoTilemap;
+
+RoTilemap ro_tilemap_new(int cols, int rows, ivec2 sheet_tiles, const float *vp, rTexture tex_sink);
+
+void ro_tilemap_kill(RoTilemap *self);
+
+// updates the map with the given buffer
+// buffer has to be the size of:
+//     4 * cols * rows
+void ro_tilemap_set(RoTilemap *self, const void *buffer);
+
+// updates a sub rect of the map, buffer is the full map (as in ro_tilemap_set)
+void ro_tilemap_set_sub(RoTilemap *self, const void *buffer, int left, int top, int cols, int rows);
+
+void ro_tilemap_render(RoTilemap *self);
+
+// resets the tiles texture, if .owns_tex is true, it will delete the old texture
+void ro_tilemap_set_texture(RoTilemap *self, rTexture tex_sink);
+
+#endif //R_RO_TILEMAP_H
@@ -0,0 +1,47 @@
+#ifndef R_STREAM_H
+#define R_STREAM_H
+
+//
+// ring of vertex buffers for data that is uploaded each frame.
+// an upload never writes into a buffer that the gpu may still read:
+//   if the fence of the next buffer is signaled, it is mapped unsynchronized,
+//   else the buffer is orphaned (the driver allocates a new storage).
+// so the cpu does not stall on the gpu.
+// each buffer remembers the range changed since its last upload, so a sub upload copies only that range.
+//
+
+#include <stdbool.h>
+#include "core.h"
+
+#define R_STREAM_RING 3
+
+typedef struct {
+    GLuint vao[R_STREAM_RING];   // vertex array object for each buffer, to be setup by the user
+    GLuint vbo[R_STREAM_RING];
+    GLsync fence[R_STREAM_RING];
+    int dirty_begin[R_STREAM_RING], dirty_end[R_STREAM_RING];  // bytes changed since the buffer was written
+    int current;                // buffer of the last upload
+    int size;                   // size of each buffer in bytes
+    int orphaned;               // number of uploads, that had to orphan a busy buffer
+    long long uploaded;         // bytes copied by all uploads
+} rStream;
+
+rStream r_stream_new(int size);
+
+void r_stream_kill(rStream *self);
+
+// copies data (of .size bytes) into the next buffer and makes it the current one
+void r_stream_upload(rStream *self, const void *data);
+
+// as r_stream_upload, but only the bytes [offset, offset+size) of data have changed.
+// data is the full buffer, the next buffer gets all changes since it was written (or all, if it is orphaned)
+void r_stream_upload_sub(rStream *self, const void *data, int offset, int size);
+
+// call after drawing with the current buffer
+void r_stream_fence(rStream *self);
+
+static GLuint r_stream_vao(rStream self) {
+    return self.vao[self.current];
+}
+
+#endif //R_STREAM_H
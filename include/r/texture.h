@@ -43,6 +43,19 @@ void r_texture_kill(rTexture *self);
 //     4 * sprite_size.x * _y * sprites.x * _y
 void r_texture_set(rTexture self, const void *buffer);
 
+// updates only the sprites [sprite_begin, sprite_end) (index = row * sprites.x + col)
+// buffer is the full sprite grid, as in r_texture_set
+void r_texture_set_sprites(rTexture self, int sprite_begin, int sprite_end, const void *buffer);
+
+// updates only the given rect of the image (in pixels of the full sprite grid)
+// buffer is the full sprite grid, as in r_texture_set
+void r_texture_set_sub(rTexture self, int left, int top, int cols, int rows, const void *buffer);
+
+// updates a single sprite of the texture with the given buffer
+// buffer has to be the size of:
+//     4 * sprite_size.x * _y
+void r_texture_set_sprite(rTexture self, int sprite_col, int sprite_row, const void *buffer);
+
 // r_texture_get not available
 // gles3 does not support 3D (2D_ARRAY) there
 
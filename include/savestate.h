@@ -1,18 +1,52 @@
 #ifndef TILEC_SAVESTATE_H
 #define TILEC_SAVESTATE_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h> // size_t
 
 #define SAVESTATE_MAX_IDS 64
 
+// older states are compressed and spilled into a temp file, if the memory exceeds the budget
+#define SAVESTATE_MEMORY_BUDGET (64 * 1024 * 1024)
+
 typedef void (*savestate_save_fn)();
 
 typedef void (*savestate_load_fn)(const void *data, size_t size);
 
+// reverts the changes of the state (delta), that is undone
+typedef void (*savestate_undo_fn)(const void *data, size_t size);
+
+// reapplies the changes of the state (delta), used to replay the journal
+typedef void (*savestate_redo_fn)(const void *data, size_t size);
+
 void savestate_init();
 
 int savestate_register(savestate_save_fn save_fn, savestate_load_fn load_fn);
 
+// the save_fn saves only the changes since the last state,
+// on undo the undo_fn gets the data of the undone state to revert it,
+// the redo_fn gets it to apply the changes again, so the data must contain the new values, too.
+// while savestate_saving_full() is true, the save_fn must save the full state (journal checkpoint)
+int savestate_register_delta(savestate_save_fn save_fn, savestate_undo_fn undo_fn, savestate_redo_fn redo_fn);
+
+// true while the save_fns are called for a journal checkpoint
+bool savestate_saving_full();
+
+// generation of the current state, new for each save and restored by an undo.
+// store it with the saved files, to check them against the journal
+uint64_t savestate_generation();
+
+// optional, call after savestate_init and before the first save.
+// disk_generation is the savestate_generation of the files on disk, or 0 if unknown.
+// restores the states of the journal file, if it knows the disk_generation (else the journal is restarted),
+// and appends all new states (and undos) to it. The journal is rewritten, if it grows too large.
+// returns true if states were restored
+bool savestate_journal_open(const char *file, uint64_t disk_generation);
+
+// default is SAVESTATE_MEMORY_BUDGET
+void savestate_set_memory_budget(size_t bytes);
+
 void savestate_save_data(const void *data, size_t size);
 
 void savestate_save();
@@ -10,14 +10,47 @@
 #define TILES_ROWS 8
 #define TILES_SIZE 16.0f
 
+// gpu memory of the loaded sheets (64 kB each), the least recently required sheets are evicted
+// the default fits all sheets, so nothing is evicted unless lowered with tiles_set_memory_budget
+#define TILES_MEMORY_BUDGET (MAX_TILES * 64 * 1024)
+
 struct TilesGlobals_s {
-    uImage imgs[MAX_TILES];
-    rTexture textures[MAX_TILES];
     int ids[MAX_TILES];
-    int size;
+    int size;   // available sheets, they are loaded on demand (see tiles_require)
+
+    // the loaded tile sheets in a single texture, sprite (0, slots[id-1]) is the sheet id
+    rTexture sheets;
+
+    // texture layer (slot) of each sheet (tile_id - 1), or -1 if not loaded
+    int slots[MAX_TILES];
+
+    // increases, if a sheet was evicted, its slot may contain another sheet now
+    int evictions;
 };
 extern struct TilesGlobals_s tiles;
 
 void tiles_init();
 
+// call once per frame, the sheets required in a frame are not evicted in that frame
+void tiles_update();
+
+// default is TILES_MEMORY_BUDGET, the texture is allocated in tiles_init.
+// later calls can only lower the used slots (the texture keeps its size)
+void tiles_set_memory_budget(size_t bytes);
+
+// loads the sheets of the tile_ids (1 based), that are not loaded yet, into slots of tiles.sheets
+// may evict the least recently required sheets, but not those required in this frame
+void tiles_require(const int *tile_ids, int n);
+
+// returns the texture layer of the sheet, or -1 if not loaded
+static int tiles_slot(int tile_id) {
+    if (tile_id <= 0 || tile_id > MAX_TILES)
+        return -1;
+    return tiles.slots[tile_id - 1];
+}
+
+static void tiles_require_id(int tile_id) {
+    tiles_require(&tile_id, 1);
+}
+
 #endif //TILEC_TILES_H
@@ -0,0 +1,30 @@
+#ifndef U_FILEMAP_H
+#define U_FILEMAP_H
+
+//
+// read only file mapping.
+// Uses mmap if available, else the file is read into memory
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    const char *data;
+    size_t size;
+} uFileMap;
+
+static bool u_filemap_valid(uFileMap self) {
+    return self.data != NULL && self.size > 0;
+}
+
+static uFileMap u_filemap_new_invalid() {
+    return (uFileMap) {0};
+}
+
+// returns an invalid map, if the file is not available or empty
+uFileMap u_filemap_new(const char *file);
+
+void u_filemap_kill(uFileMap *self);
+
+#endif //U_FILEMAP_H
@@ -0,0 +1,22 @@
+#ifndef U_FILL_H
+#define U_FILL_H
+
+//
+// fill operations on the raw pixels of an image layer
+//
+
+#include <stdbool.h>
+#include "image.h"
+
+// replaces all pixels == from with to, returns true if any changed
+// a pixel is handled as a single 32 bit word, 4 at a time with SSE2 or NEON (if available)
+bool u_fill_replace_row(uColor_s *row, int n, uColor_s from, uColor_s to);
+
+// span (scanline) flood fill of the pixels equal to the seed pixel with color,
+// inside of the rect [left, right) x [top, bottom). mode8 also fills diagonal neighbours
+// returns false if nothing was filled, else the bounding box of the filled pixels
+bool u_fill_spans(uImage img, int layer, int seed_c, int seed_r, uColor_s color, bool mode8,
+                  int left, int top, int right, int bottom,
+                  int *out_left, int *out_top, int *out_cols, int *out_rows);
+
+#endif //U_FILL_H
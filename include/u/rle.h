@@ -0,0 +1,23 @@
+#ifndef U_RLE_H
+#define U_RLE_H
+
+//
+// run length encoding of 4 byte words (pixels), suits image data with large uniform runs
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// worst case size of an encoded buffer
+static size_t u_rle_encode_bound(size_t src_size) {
+    return src_size + 4 * (src_size / 4 / 0x7fffffff + 2);
+}
+
+// returns the encoded size, or 0 if dst_size is too small
+size_t u_rle_encode(void *dst, size_t dst_size, const void *src, size_t src_size);
+
+// dst_size must be the size of the decoded data (src_size of u_rle_encode)
+// returns false if src is invalid
+bool u_rle_decode(void *dst, size_t dst_size, const void *src, size_t src_size);
+
+#endif //U_RLE_H
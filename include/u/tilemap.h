@@ -0,0 +1,32 @@
+#ifndef U_TILEMAP_H
+#define U_TILEMAP_H
+
+//
+// native tilemap file format.
+// The image is stored in chunks per layer, each empty, raw or rle encoded.
+// Files are loaded by mmap and only changed chunks are written.
+// The chunk index is double buffered with a checksum, so a torn write keeps the previous image
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "image.h"
+
+#define U_TILEMAP_CHUNK_SIZE 64
+
+// loads the file into self, which must have the size of the file
+// returns false if the file is not available, invalid or of another size
+// opt_out_tag is set to the tag of the save
+bool u_tilemap_load_file(uImage self, const char *file, uint64_t *opt_out_tag);
+
+// writes only the chunks in the region (left, top, cols, rows).
+// If the file is not available, of another size or too fragmented, the whole file is written
+// tag is a user value stored with the chunk index
+bool u_tilemap_save_file_region(uImage self, const char *file, int left, int top, int cols, int rows,
+                                uint64_t tag);
+
+static bool u_tilemap_save_file(uImage self, const char *file, uint64_t tag) {
+    return u_tilemap_save_file_region(self, file, 0, 0, self.cols, self.rows, tag);
+}
+
+#endif //U_TILEMAP_H
@@ -9,5 +9,9 @@
 #include "image.h"
 #include "pose.h"
 #include "prandom.h"
+#include "rle.h"
+#include "filemap.h"
+#include "tilemap.h"
+#include "fill.h"
 
 #endif //U_U_H
@@ -0,0 +1,76 @@
+#ifdef VERTEX
+
+    layout(location = 0) in vec4 in_pose;
+    // xy, size
+
+    layout(location = 1) in vec4 in_uv;
+    // uv_xy, uv_size
+
+    layout(location = 2) in float in_angle;
+    layout(location = 3) in vec4 in_color;
+    layout(location = 4) in vec2 in_sprite;
+
+    out vec3 v_tex_coord;
+    out vec4 v_color;
+
+    uniform mat4 vp;
+    uniform vec2 sprites;
+
+    const vec2 vertices[6] = vec2[](
+    vec2(-0.5, -0.5),
+    vec2(+0.5, -0.5),
+    vec2(-0.5, +0.5),
+    vec2(-0.5, +0.5),
+    vec2(+0.5, -0.5),
+    vec2(+0.5, +0.5)
+    );
+
+    // 0-1 may overlap, so using 0-0.9999999 instead
+    const vec2 tex_coords[6] = vec2[](
+    vec2(0.0000000, 0.9999999),
+    vec2(0.9999999, 0.9999999),
+    vec2(0.0000000, 0.0000000),
+    vec2(0.0000000, 0.0000000),
+    vec2(0.9999999, 0.9999999),
+    vec2(0.9999999, 0.0000000)
+    );
+
+    void main() {
+        // same as u_pose_new_angle
+        vec2 v = vertices[gl_VertexID] * in_pose.zw;
+        float c = cos(in_angle);
+        float s = sin(in_angle);
+        v = vec2(c * v.x - s * v.y, s * v.x + c * v.y) + in_pose.xy;
+        gl_Position = vp * vec4(v, 0, 1);
+
+        v_tex_coord.xy = in_uv.xy + tex_coords[gl_VertexID] * in_uv.zw;
+
+        // glsl: actual_layer = max(0, min(d​ - 1, floor(layer​ + 0.5)) )
+        vec2 s_pos = floor(mod(in_sprite+0.5, sprites));
+        s_pos = clamp(s_pos, vec2(0), sprites-1.0);
+        v_tex_coord.z = s_pos.y * sprites.x + s_pos.x;
+
+        v_color = in_color;
+    }
+
+#endif
+
+
+#ifdef FRAGMENT
+    #ifdef OPTION_GLES
+        precision mediump float;
+        precision lowp sampler2DArray;
+    #endif
+
+    in vec3 v_tex_coord;
+    in vec4 v_color;
+
+    out vec4 out_frag_color;
+
+    uniform sampler2DArray tex;
+
+    void main() {
+        out_frag_color = texture(tex, v_tex_coord) * v_color;
+    }
+
+#endif
@@ -0,0 +1,80 @@
+#ifdef VERTEX
+
+    out vec2 v_map_coord;
+    out vec4 v_color;
+
+    uniform mat4 pose;
+    uniform mat4 uv;
+    uniform vec4 color;
+
+    uniform mat4 vp;
+
+    const vec4 vertices[6] = vec4[](
+    vec4(-0.5, -0.5, 0, 1),
+    vec4(+0.5, -0.5, 0, 1),
+    vec4(-0.5, +0.5, 0, 1),
+    vec4(-0.5, +0.5, 0, 1),
+    vec4(+0.5, -0.5, 0, 1),
+    vec4(+0.5, +0.5, 0, 1)
+    );
+
+    // 0-1 may overlap, so using 0-0.9999999 instead
+    const vec4 tex_coords[6] = vec4[](
+    vec4(0.0000000, 0.9999999, 0, 1),
+    vec4(0.9999999, 0.9999999, 0, 1),
+    vec4(0.0000000, 0.0000000, 0, 1),
+    vec4(0.0000000, 0.0000000, 0, 1),
+    vec4(0.9999999, 0.9999999, 0, 1),
+    vec4(0.9999999, 0.0000000, 0, 1)
+    );
+
+    void main() {
+        gl_Position = vp * pose * vertices[gl_VertexID];
+        v_map_coord = (uv * tex_coords[gl_VertexID]).xy;
+        v_color = color;
+    }
+#endif
+
+
+#ifdef FRAGMENT
+    #ifdef OPTION_GLES
+        // map coords of big maps need more than mediump
+        precision highp float;
+        precision lowp sampler2D;
+        precision lowp sampler2DArray;
+    #endif
+
+    in vec2 v_map_coord;
+    in vec4 v_color;
+
+    out vec4 out_frag_color;
+
+    uniform sampler2D map;
+    uniform sampler2DArray tex;
+
+    uniform vec2 map_size;
+    uniform vec2 sheet_tiles;
+    uniform float sheets;
+    uniform int slots[128];     // texture layer of each sheet (id - 1), < 0 if not loaded
+
+    void main() {
+        vec2 cell = v_map_coord * map_size;
+        ivec2 cell_idx = clamp(ivec2(floor(cell)), ivec2(0), ivec2(map_size) - 1);
+
+        // color code: b = sheet id, a = tile index
+        vec4 code = texelFetch(map, cell_idx, 0);
+        float sheet = floor(code.b * 255.0 + 0.5);
+        float tile = floor(code.a * 255.0 + 0.5);
+        if (sheet < 1.0 || sheet > sheets)
+            discard;
+        int layer = slots[int(sheet) - 1];
+        if (layer < 0)
+            discard;
+
+        vec2 tile_pos = vec2(mod(tile, sheet_tiles.x), floor(tile / sheet_tiles.x));
+        vec2 tex_coord = (tile_pos + fract(cell)) / sheet_tiles;
+
+        out_frag_color = texture(tex, vec3(tex_coord, float(layer))) * v_color;
+    }
+
+#endif
@@ -23,6 +23,7 @@ static struct {
     int frames;
     float time;
     float fps;
+    int generation;     // of the canvas image in the textures
 } L;
 
 static void set_pose(int c, int r) {
@@ -63,7 +64,9 @@ void animation_init(int multi_cols, int multi_rows, float size, int frames, floa
     for (int i = 0; i < img.layers; i++) {
         rTexture tex = r_texture_new(img.cols, img.rows, frames, 1, u_image_layer(img, i));
         L.ro[i] = ro_batch_new(L.mcols * L.mrows, camera.gl, tex);
+        ro_batch_set_streaming(&L.ro[i], true);  // updated each frame
     }
+    L.generation = canvas_generation();
 
     L.horsimann = ro_text_new_font55(9, camera.gl);
     ro_text_set_color(&L.horsimann, (vec4) {{0.25, 0.25, 0.25, 1}});
@@ -97,9 +100,16 @@ void animation_update(float dtime) {
         }
     }
 
+    // upload only the changes of the canvas, all layers so a layer switch needs none
     uImage img = canvas_image();
+    int left, top, cols, rows;
+    if (canvas_changed_since(L.generation, &left, &top, &cols, &rows)) {
+        for (int i = 0; i < img.layers; i++)
+            r_texture_set_sub(L.ro[i].L.tex, left, top, cols, rows, u_image_layer(img, i));
+        L.generation = canvas_generation();
+    }
+
     for (int i = 0; i <= canvas.current_layer; i++) {
-        r_texture_set(L.ro[i].L.tex, u_image_layer(img, i));
         ro_batch_update(&L.ro[i]);
     }
 }
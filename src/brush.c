@@ -105,6 +105,7 @@ void brush_init() {
     brush.secondary_color = U_COLOR_TRANSPARENT;
     brush.mode = BRUSH_MODE_FREE;
     brush.shape = 0;
+    brush.circle_radius = 0;
     brush.shading_active = false;
 }
 
@@ -173,6 +174,7 @@ bool brush_draw_pixel(int c, int r) {
     }
 
     *pixel = brush.current_color;
+    canvas_mark_dirty(c, r, 1, 1);
     return true;
 }
 
@@ -185,6 +187,11 @@ bool brush_draw(int c, int r) {
     return brushshape_draw(c, r);
 }
 
+bool brush_draw_step(int c, int r, int dc, int dr) {
+    bool dither = brush.mode == BRUSH_MODE_DITHER || brush.mode == BRUSH_MODE_DITHER2;
+    return brushshape_draw_step(c, r, dc, dr, dither, brush.mode == BRUSH_MODE_DITHER);
+}
+
 void brush_abort_current_draw() {
     log_info("brush: abort_current_draw");
     if (L.change) {
@@ -1,6 +1,8 @@
 #include "mathc/int.h"
+#include "mathc/mat/float.h"
 #include "brush.h"
 #include "canvas.h"
+#include "canvascam.h"
 #include "brushmode.h"
 
 
@@ -10,36 +12,34 @@
 
 static struct {
     bool is_drawing;
-    ivec2 last;
+    ivec2 last;     // drawn in the current stroke
 } L;
 
+// integer bresenham, stamps each cell of the line (excluding from, which is already drawn)
+// each unit step only draws the leading edge of the brush
 static bool lineto(ivec2 from, ivec2 to) {
-
-    int sign_x = 1, sign_y = 1;
-    if (from.x > to.x)
-        sign_x = -1;
-    if (from.y > to.y)
-        sign_y = -1;
-
-    int dy = abs(to.y - from.y);
     int dx = abs(to.x - from.x);
+    int dy = -abs(to.y - from.y);
+    int sign_x = from.x < to.x ? 1 : -1;
+    int sign_y = from.y < to.y ? 1 : -1;
+    int err = dx + dy;
 
     bool changed = false;
-    if (dx == 0) {
-        for (int i = 0; i <= dy; i++)
-            changed |= brush_draw(from.x, from.y + i * sign_y);
-        return changed;
+    while (from.x != to.x || from.y != to.y) {
+        int e2 = 2 * err;
+        ivec2 step = {{0, 0}};
+        if (e2 >= dy) {
+            err += dy;
+            step.x = sign_x;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            step.y = sign_y;
+        }
+        from.x += step.x;
+        from.y += step.y;
+        changed |= brush_draw_step(from.x, from.y, step.x, step.y);
     }
-
-    float m = (float) dy / dx;
-    if (m <= 1) {
-        for (int i = 0; i <= dx; i++)
-            changed |= brush_draw(from.x + i * sign_x, (from.y + i * m * sign_y));
-        return changed;
-    }
-
-    for (int i = 0; i <= dy; i++)
-        changed |= brush_draw((from.x + i * m * sign_x), from.y + i * sign_y);
     return changed;
 }
 
@@ -61,25 +61,13 @@ bool brushmode_dot(ePointer_s pointer) {
 }
 
 bool brushmode_free(ePointer_s pointer) {
-    if (pointer.action == E_POINTER_DOWN) {
-        L.is_drawing = true;
-    } else if (pointer.action != E_POINTER_MOVE) {
-        L.is_drawing = false;
-    }
-
-    if (!L.is_drawing)
-        return false;
-
-    ivec2 cr = canvas_get_cr(pointer.pos);
-    return brush_draw(cr.x, cr.y);
-}
-
-bool brushmode_free_line(ePointer_s pointer) {
     ivec2 cr = canvas_get_cr(pointer.pos);
 
+    bool changed = false;
     if (pointer.action == E_POINTER_DOWN) {
         L.is_drawing = true;
         L.last = cr;
+        changed = brush_draw(cr.x, cr.y);
     } else if (pointer.action != E_POINTER_MOVE) {
         L.is_drawing = false;
     }
@@ -87,11 +75,20 @@ bool brushmode_free_line(ePointer_s pointer) {
     if (!L.is_drawing)
         return false;
 
-    // just 1 pixel length
-    if (ivec2_norm_inf(ivec2_sub_vec(cr, L.last)) <= 1)
-        return brush_draw(cr.x, cr.y);
+    // a coalesced move contains all samples of the frame, the last one is pointer
+    if (pointer.action == E_POINTER_MOVE) {
+        int size;
+        const ePointerSample_s *history = e_input_pointer_history(&size);
+        for (int i = 0; i < size - 1; i++) {
+            vec4 pos = mat4_mul_vec(canvascam.matrices.v_p_inv, history[i].pointer.pos);
+            ivec2 sample = canvas_get_cr(pos);
+            changed |= lineto(L.last, sample);
+            L.last = sample;
+        }
+    }
 
-    bool changed = lineto(L.last, cr);
+    // fast strokes are continuous, by drawing the line from the last pointer position
+    changed |= lineto(L.last, cr);
     L.last = cr;
     return changed;
 }
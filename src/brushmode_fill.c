@@ -1,14 +1,11 @@
+#include "mathc/sca/int.h"
+#include "u/fill.h"
 #include "canvas.h"
+#include "selection.h"
 #include "brush.h"
 #include "brushmode.h"
 
 
-#define TYPE ivec2
-#define CLASS PosStack
-#define FN_NAME posstack
-#include "rhc/dynarray.h"
-
-
 bool brushmode_fill(ePointer_s pointer, bool mode8) {
     if (pointer.action != E_POINTER_DOWN)
         return false;
@@ -17,51 +14,28 @@ bool brushmode_fill(ePointer_s pointer, bool mode8) {
     int layer = canvas.current_layer;
 
     ivec2 cr = canvas_get_cr(pointer.pos);
-    if (!u_image_contains(img, cr.x, cr.y))
+    if (!u_image_contains(img, cr.x, cr.y) || !selection_contains(cr.x, cr.y))
         return false;
 
     brush.secondary_color = *u_image_pixel(img, cr.x, cr.y, layer);
     if (u_color_equals(brush.current_color, brush.secondary_color))
         return false;
 
-    bool shading_was_active = brush.shading_active;
-    brush.shading_active = true;
-
-    // PosStack needs to be killed
-    PosStack stack = posstack_new(32);
-    posstack_push(&stack, cr);
-
-    while (stack.size > 0) {
-        ivec2 p = posstack_pop(&stack);
-
-        if (!brush_draw_pixel(p.x, p.y))
-            continue;
-
-        posstack_push(&stack,
-                       (ivec2) {{p.x - 1, p.y}});
-        posstack_push(&stack,
-                       (ivec2) {{p.x + 1, p.y}});
-        posstack_push(&stack,
-                       (ivec2) {{p.x, p.y - 1}});
-        posstack_push(&stack,
-                       (ivec2) {{p.x, p.y + 1}});
-
-        // mode8 edges
-        if (!mode8)
-            continue;
-        posstack_push(&stack,
-                       (ivec2) {{p.x - 1, p.y - 1}});
-        posstack_push(&stack,
-                       (ivec2) {{p.x + 1, p.y - 1}});
-        posstack_push(&stack,
-                       (ivec2) {{p.x - 1, p.y + 1}});
-        posstack_push(&stack,
-                       (ivec2) {{p.x + 1, p.y + 1}});
+    // fill only inside of the selection
+    int left = 0, top = 0, right = img.cols, bottom = img.rows;
+    if (selection_active()) {
+        ivec2 pos = selection_pos();
+        ivec2 size = selection_size();
+        left = isca_max(left, pos.x);
+        top = isca_max(top, pos.y);
+        right = isca_min(right, pos.x + size.x);
+        bottom = isca_min(bottom, pos.y + size.y);
     }
 
-    posstack_kill(&stack);
-
-    brush.shading_active = shading_was_active;
+    int l, t, cols, rows;
+    if (u_fill_spans(img, layer, cr.x, cr.y, brush.current_color, mode8, left, top, right, bottom,
+                     &l, &t, &cols, &rows))
+        canvas_mark_dirty(l, t, cols, rows);
     return true;
 }
 
@@ -80,16 +54,28 @@ bool brushmode_replace(ePointer_s pointer) {
     if (u_color_equals(brush.current_color, brush.secondary_color))
         return false;
 
-    bool shading_was_active = brush.shading_active;
-    brush.shading_active = true;
+    // replace only inside of the selection
+    int left = 0, top = 0, right = img.cols, bottom = img.rows;
+    if (selection_active()) {
+        ivec2 pos = selection_pos();
+        ivec2 size = selection_size();
+        left = isca_max(left, pos.x);
+        top = isca_max(top, pos.y);
+        right = isca_min(right, pos.x + size.x);
+        bottom = isca_min(bottom, pos.y + size.y);
+    }
 
-    for (int r = 0; r < img.rows; r++) {
-        for (int c = 0; c < img.cols; c++) {
-            brush_draw_pixel(c, r);
-        }
+    int dirty_top = bottom, dirty_bottom = top;
+    for (int r = top; r < bottom && left < right; r++) {
+        uColor_s *row = u_image_pixel(img, left, r, layer);
+        if (!u_fill_replace_row(row, right - left, brush.secondary_color, brush.current_color))
+            continue;
+        dirty_top = isca_min(dirty_top, r);
+        dirty_bottom = r + 1;
     }
+    if (dirty_top >= dirty_bottom)
+        return false;
 
-    brush.shading_active = shading_was_active;
+    canvas_mark_dirty(left, dirty_top, right - left, dirty_bottom - dirty_top);
     return true;
 }
-
@@ -1,11 +1,190 @@
+#include <string.h>
 #include "r/texture.h"
 #include "u/pose.h"
 #include "u/image.h"
+#include "mathc/sca/int.h"
 #include "rhc/error.h"
 #include "rhc/allocator.h"
+#include "canvas.h"
+#include "selection.h"
 #include "brush.h"
 #include "brushshape.h"
 
+
+//
+// private
+//
+
+// a row of the shape, relative to its center
+typedef struct {
+    int row;
+    int left, right;    // [left, right)
+} Span;
+
+// spans of the current shape, compiled on a shape change
+// spans[0:num] are the shape, followed by the leading edge of each unit step
+static struct {
+    int shape;
+    int circle_radius;
+    Span *spans;
+    int num;
+    int capacity;
+    int edge_begin[9], edge_end[9];     // [(dr + 1) * 3 + dc + 1]
+} L = {-1};
+
+static void push_span(int row, int left, int right) {
+    if (L.num >= L.capacity) {
+        L.capacity = L.capacity * 2 + 16;
+        L.spans = rhc_realloc_raising(L.spans, L.capacity * sizeof *L.spans);
+    }
+    L.spans[L.num++] = (Span) {row, left, right};
+}
+
+static void compile_kernel(int shape) {
+    for (int kr = 0; kr < BRUSH_KERNEL_SIZE; kr++) {
+        int kc = 0;
+        while (kc < BRUSH_KERNEL_SIZE) {
+            if (!brushshape.kernels[shape][kr][kc]) {
+                kc++;
+                continue;
+            }
+            int begin = kc;
+            while (kc < BRUSH_KERNEL_SIZE && brushshape.kernels[shape][kr][kc])
+                kc++;
+            push_span(kr - BRUSH_KERNEL_SIZE / 2,
+                      begin - BRUSH_KERNEL_SIZE / 2,
+                      kc - BRUSH_KERNEL_SIZE / 2);
+        }
+    }
+}
+
+// all cells with a center inside of radius + 0.5
+static void compile_circle(int radius) {
+    int rr = radius * radius + radius;
+    for (int dr = -radius; dr <= radius; dr++) {
+        int half = (int) sqrtf((float) (rr - dr * dr));
+        while (half * half > rr - dr * dr)
+            half--;
+        while ((half + 1) * (half + 1) <= rr - dr * dr)
+            half++;
+        push_span(dr, -half, half + 1);
+    }
+}
+
+// cells of the shape, that the shape one step (dc, dr) back does not contain
+static void compile_edges(int shape_num) {
+    // mask of the shape with a border of 1
+    int half = 0;
+    for (int i = 0; i < shape_num; i++) {
+        half = isca_max(half, isca_abs(L.spans[i].row));
+        half = isca_max(half, isca_max(-L.spans[i].left, L.spans[i].right - 1));
+    }
+    half++;
+    int size = 2 * half + 1;
+    bool *mask = rhc_malloc_raising(size * size * sizeof *mask);
+    memset(mask, 0, size * size * sizeof *mask);
+    for (int i = 0; i < shape_num; i++) {
+        for (int x = L.spans[i].left; x < L.spans[i].right; x++)
+            mask[(L.spans[i].row + half) * size + x + half] = true;
+    }
+
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+            int d = (dr + 1) * 3 + dc + 1;
+            L.edge_begin[d] = L.num;
+            for (int y = -half + 1; y < half && (dc || dr); y++) {
+                int x = -half + 1;
+                while (x < half) {
+                    const bool *row = &mask[(y + half) * size + half];
+                    const bool *prev = &mask[(y + dr + half) * size + half + dc];
+                    if (!row[x] || prev[x]) {
+                        x++;
+                        continue;
+                    }
+                    int begin = x;
+                    while (x < half && row[x] && !prev[x])
+                        x++;
+                    push_span(y, begin, x);
+                }
+            }
+            L.edge_end[d] = L.num;
+        }
+    }
+    rhc_free(mask);
+}
+
+static void compile_spans() {
+    if (L.shape == brush.shape && L.circle_radius == brush.circle_radius)
+        return;
+    L.shape = brush.shape;
+    L.circle_radius = brush.circle_radius;
+    L.num = 0;
+    if (brush.circle_radius > 0)
+        compile_circle(brush.circle_radius);
+    else
+        compile_kernel(brush.shape);
+    int shape_num = L.num;
+    compile_edges(shape_num);
+    L.num = shape_num;
+}
+
+// stamps the spans [begin, end) row wise, clipped to the image and the selection
+static bool draw_spans(int c, int r, int begin, int end, bool dither, bool a) {
+    uImage img = canvas_image();
+    int layer = canvas.current_layer;
+    int left = 0, top = 0, right = img.cols, bottom = img.rows;
+    if (selection_active()) {
+        ivec2 pos = selection_pos();
+        ivec2 size = selection_size();
+        left = isca_max(left, pos.x);
+        top = isca_max(top, pos.y);
+        right = isca_min(right, pos.x + size.x);
+        bottom = isca_min(bottom, pos.y + size.y);
+    }
+
+    int dirty_left = right, dirty_top = bottom, dirty_right = left, dirty_bottom = top;
+    for (int i = begin; i < end; i++) {
+        int y = r + L.spans[i].row;
+        int l = isca_max(c + L.spans[i].left, left);
+        int rgt = isca_min(c + L.spans[i].right, right);
+        if (y < top || y >= bottom || l >= rgt)
+            continue;
+
+        // dither draws only on cells with an (c + r) parity != a
+        int step = 1;
+        if (dither) {
+            if ((l + y) % 2 == a)
+                l++;
+            step = 2;
+        }
+
+        uColor_s *row = u_image_pixel(img, 0, y, layer);
+        bool changed = false;
+        for (int x = l; x < rgt; x += step) {
+            if (brush.shading_active && !u_color_equals(row[x], brush.secondary_color))
+                continue;
+            row[x] = brush.current_color;
+            changed = true;
+        }
+        if (!changed)
+            continue;
+        dirty_left = isca_min(dirty_left, l);
+        dirty_right = isca_max(dirty_right, rgt);
+        dirty_top = isca_min(dirty_top, y);
+        dirty_bottom = isca_max(dirty_bottom, y + 1);
+    }
+
+    if (dirty_left >= dirty_right)
+        return false;
+    canvas_mark_dirty(dirty_left, dirty_top, dirty_right - dirty_left, dirty_bottom - dirty_top);
+    return true;
+}
+
+
+//
+// public
+//
+
 rTexture brushshape_create_kernel_texture(uColor_s bg, uColor_s fg) {
     uImage img = u_image_new_empty(BRUSH_KERNEL_TEXTURE_SIZE, BRUSH_KERNEL_TEXTURE_SIZE, BRUSH_NUM_SHAPES);
 
@@ -33,39 +212,19 @@ rTexture brushshape_create_kernel_texture(uColor_s bg, uColor_s fg) {
 }
 
 bool brushshape_draw(int c, int r) {
-    bool changed = false;
-    for (int kr = 0; kr < BRUSH_KERNEL_SIZE; kr++) {
-        int dr = r + kr - BRUSH_KERNEL_SIZE / 2;
-
-        for (int kc = 0; kc < BRUSH_KERNEL_SIZE; kc++) {
-            int dc = c + kc - BRUSH_KERNEL_SIZE / 2;
-
-            if (brushshape.kernels[brush.shape]
-            [kr][kc]) {
-
-                changed |= brush_draw_pixel(dc, dr);
-            }
-        }
-    }
-    return changed;
+    compile_spans();
+    return draw_spans(c, r, 0, L.num, false, false);
 }
 
 bool brushshape_draw_dither(int c, int r, bool a) {
-    bool changed = false;
-    for (int kr = 0; kr < BRUSH_KERNEL_SIZE; kr++) {
-        int dr = r + kr - BRUSH_KERNEL_SIZE / 2;
-
-        for (int kc = 0; kc < BRUSH_KERNEL_SIZE; kc++) {
-            int dc = c + kc - BRUSH_KERNEL_SIZE / 2;
-
-            if (brushshape.kernels[brush.shape]
-            [kr][kc]) {
-
-                if ((dc % 2 + dr % 2) % 2 == a ? 0 : 1)
-                    changed |= brush_draw_pixel(dc, dr);
-            }
-        }
-    }
-    return changed;
+    compile_spans();
+    return draw_spans(c, r, 0, L.num, true, a);
 }
 
+bool brushshape_draw_step(int c, int r, int dc, int dr, bool dither, bool a) {
+    compile_spans();
+    if (dc < -1 || dc > 1 || dr < -1 || dr > 1)
+        return draw_spans(c, r, 0, L.num, dither, a);
+    int d = (dr + 1) * 3 + dc + 1;
+    return draw_spans(c, r, L.edge_begin[d], L.edge_end[d], dither, a);
+}
@@ -1,10 +1,20 @@
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <SDL.h>
 #include "r/ro_single.h"
-#include "r/ro_batch.h"
+#include "r/ro_batch2d.h"
+#include "r/ro_tilemap.h"
+#include "r/render.h"
 #include "r/texture.h"
+#include "r/framebuffer.h"
 #include "u/pose.h"
-#include "mathc/mat/float.h"
+#include "u/tilemap.h"
+#include "mathc/float.h"
+#include "mathc/utils/camera.h"
+#include "rhc/allocator.h"
 
 #include "tiles.h"
 #include "canvascam.h"
@@ -16,6 +26,11 @@
 
 #define MAX_LAYERS 16
 #define SELECTION_BORDER_FACTOR 4
+#define LAYER_START_SLOTS 256
+#define CULL_MARGIN 2
+#define VIEW_MARGIN_FACTOR 4    // view = visible + size/factor on each side
+#define CHANGE_HISTORY 64       // generations, canvas_changed_since can merge
+#define PNG_EXPORT_INTERVAL 60.0    // seconds, the png file is written at most that often while editing
 
 
 
@@ -29,6 +44,31 @@ struct CanvasGlobals_s canvas = {
 // private
 //
 
+// region of the image in cols and rows, right and bottom are exclusive
+typedef struct {
+    int left, top, right, bottom;
+} Region;
+
+// a layer is rendered as tilemap, or if the map is too big for a texture,
+// as compacted render list, in which only occupied cells get a rect (slot)
+typedef struct {
+    RoTilemap map;
+
+    RoBatch2d ro;       // rects[0:size] are rendered
+    int size;
+    int *cell_slots;    // slot for each cell, or -1 if empty
+    int *slot_cells;    // cell index for each slot
+    int update_begin, update_end;   // changed slots, to upload
+} Layer;
+
+// undo record of a canvas_save: the previous and new pixels of the changed region
+// a full record (savestate_saving_full) has only the new pixels of the whole image
+typedef struct {
+    Region region;
+    bool has_prev;
+    uColor_s data[];    // ([layer][row][col] prev), [layer][row][col] new of the region
+} Delta;
+
 static struct {
     mat4 pose;
     mat4 mvp;
@@ -39,45 +79,351 @@ static struct {
     RoSingle bg;
     RoSingle grid;
 
-    RoBatch selection_border;
-
-    RoBatch tiles[MAX_LAYERS][MAX_TILES];
+    RoBatch2d selection_border;
+
+    Layer layers[MAX_LAYERS];
+    bool use_tilemap;
+
+    Region dirty;       // needs to be rebuild into the render objects
+    Region unsaved;     // changed since the last canvas_save
+    Region changed;     // changed since the last generation
+    int generation;
+    Region history[CHANGE_HISTORY];     // changed region of each generation
+    Region view;        // contains the visible cells, only those are rendered
+    float view_px;      // real pixels per cell, when the view was set
+    int last_layer;
+    float last_alpha;
+    int tiles_evictions;    // tiles.evictions, when the view was required
+
+    // sheets used in the view (all layers), required each frame, so the palette can not evict them
+    // cleared on a view change, edits only add to it
+    int view_sheets[MAX_TILES];
+    int view_sheets_size;
+
+    // composite of the layers below the current layer, rendered into a texture
+    RoSingle cache;
+    rFramebuffer cache_fb;
+    bool cache_valid;
+
+    // background writer of the image file
+    struct {
+        SDL_Thread *thread;
+        SDL_mutex *lock;
+        SDL_cond *cond;
+        uImage pending;     // newest snapshot to write, or invalid
+        Region pending_region;  // changed since the last written snapshot
+        uImage spare;       // written snapshot to reuse, or invalid
+        uint64_t pending_tag;   // savestate generation of the pending snapshot
+        bool pending_export;    // also write the png file
+        bool busy;
+    } autosave;
+
+    Region unwritten;   // redone by the savestate, written in canvas_update
+    uint64_t file_generation;   // savestate generation of the loaded tilemap file, or 0
+
+    // native working file, the png file is kept as export
+    char tilemap_file[256];
+    bool png_outdated;      // the image changed since the last png export
+    float png_time;         // since the last png export
 
     int save_id;
 } L;
 
-static void init_tile_ro(RoBatch *ro, rTexture tex) {
+static Region region_new_empty() {
+    return (Region) {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+}
+
+static bool region_empty(Region self) {
+    return self.right <= self.left || self.bottom <= self.top;
+}
+
+static Region region_union(Region a, Region b) {
+    return (Region) {
+            a.left < b.left ? a.left : b.left,
+            a.top < b.top ? a.top : b.top,
+            a.right > b.right ? a.right : b.right,
+            a.bottom > b.bottom ? a.bottom : b.bottom
+    };
+}
+
+static Region region_intersection(Region a, Region b) {
+    return (Region) {
+            a.left > b.left ? a.left : b.left,
+            a.top > b.top ? a.top : b.top,
+            a.right < b.right ? a.right : b.right,
+            a.bottom < b.bottom ? a.bottom : b.bottom
+    };
+}
+
+static bool region_equals(Region a, Region b) {
+    return a.left == b.left && a.top == b.top
+           && a.right == b.right && a.bottom == b.bottom;
+}
+
+static bool region_contains(Region self, int c, int r) {
+    return c >= self.left && c < self.right
+           && r >= self.top && r < self.bottom;
+}
+
+static bool region_contains_region(Region self, Region other) {
+    return other.left >= self.left && other.right <= self.right
+           && other.top >= self.top && other.bottom <= self.bottom;
+}
+
+// copies the region for all layers
+static void region_copy(uImage dst, uImage src, Region r) {
+    size_t row_size = (r.right - r.left) * sizeof(uColor_s);
+    for (int layer = 0; layer < dst.layers; layer++) {
+        for (int row = r.top; row < r.bottom; row++) {
+            memcpy(u_image_pixel(dst, r.left, row, layer),
+                   u_image_pixel(src, r.left, row, layer), row_size);
+        }
+    }
+}
+
+static bool region_image_equals(uImage a, uImage b, Region r) {
+    size_t row_size = (r.right - r.left) * sizeof(uColor_s);
+    for (int layer = 0; layer < a.layers; layer++) {
+        for (int row = r.top; row < r.bottom; row++) {
+            if (memcmp(u_image_pixel(a, r.left, row, layer),
+                       u_image_pixel(b, r.left, row, layer), row_size) != 0)
+                return false;
+        }
+    }
+    return true;
+}
+
+// real (screen) pixels per cell
+static float cell_pixels() {
+    float cell_w = u_pose_get_w(L.pose) / L.image.cols;
+    float cam_w = u_pose_get_w(canvascam.matrices.v);
+    return cell_w * canvascam_real_pixel_per_pixel() / cam_w;
+}
+
+// image content changed
+static void mark_changed(Region r) {
+    L.dirty = region_union(L.dirty, r);
+    L.changed = region_union(L.changed, r);
+}
+
+// cells seen by the canvascam, with a margin of CULL_MARGIN
+static Region visible_region() {
+    mat4 pose_inv = mat4_inv(L.pose);
+    vec2 corners[4] = {
+            {{canvascam_left(), canvascam_top()}},
+            {{canvascam_right(), canvascam_top()}},
+            {{canvascam_left(), canvascam_bottom()}},
+            {{canvascam_right(), canvascam_bottom()}}
+    };
+
+    float min_c = FLT_MAX, min_r = FLT_MAX;
+    float max_c = -FLT_MAX, max_r = -FLT_MAX;
+    for (int i = 0; i < 4; i++) {
+        // camera -> world -> canvas
+        vec4 pos = {{corners[i].x, corners[i].y, 0, 1}};
+        pos = mat4_mul_vec(canvascam.matrices.v, pos);
+        pos = mat4_mul_vec(pose_inv, pos);
+
+        float c = (pos.x + 0.5) * L.image.cols;
+        float r = (0.5 - pos.y) * L.image.rows;
+        min_c = c < min_c ? c : min_c;
+        min_r = r < min_r ? r : min_r;
+        max_c = c > max_c ? c : max_c;
+        max_r = r > max_r ? r : max_r;
+    }
+
+    Region view = {
+            (int) floorf(min_c) - CULL_MARGIN,
+            (int) floorf(min_r) - CULL_MARGIN,
+            (int) ceilf(max_c) + CULL_MARGIN,
+            (int) ceilf(max_r) + CULL_MARGIN
+    };
+    return region_intersection(view, (Region) {0, 0, L.image.cols, L.image.rows});
+}
+
+// visible region with an additional margin, so small camera moves keep the view
+static Region view_region(Region visible) {
+    int mc = (visible.right - visible.left) / VIEW_MARGIN_FACTOR;
+    int mr = (visible.bottom - visible.top) / VIEW_MARGIN_FACTOR;
+    Region view = {visible.left - mc, visible.top - mr, visible.right + mc, visible.bottom + mr};
+    return region_intersection(view, (Region) {0, 0, L.image.cols, L.image.rows});
+}
+
+static void layer_mark_update(Layer *self, int slot) {
+    if (slot < self->update_begin)
+        self->update_begin = slot;
+    if (slot + 1 > self->update_end)
+        self->update_end = slot + 1;
+}
+
+static void layer_init(Layer *self) {
+    int cells = L.image.cols * L.image.rows;
+    self->ro = ro_batch2d_new(LAYER_START_SLOTS, &L.mvp.m00, tiles.sheets);
+    self->ro.owns_tex = false; // tiles.h owns it
+    self->size = 0;
+    self->cell_slots = rhc_malloc_raising(cells * sizeof(int));
+    for (int i = 0; i < cells; i++)
+        self->cell_slots[i] = -1;
+    self->slot_cells = rhc_malloc_raising(self->ro.num * sizeof(int));
+    self->update_begin = INT_MAX;
+    self->update_end = 0;
+}
+
+// doubles the available slots
+static void layer_grow(Layer *self) {
+    RoBatch2d ro = ro_batch2d_new(self->ro.num * 2, &L.mvp.m00, tiles.sheets);
+    ro.owns_tex = false; // tiles.h owns it
+    memcpy(ro.rects, self->ro.rects, self->size * sizeof(rRect2d_s));
+    ro_batch2d_kill(&self->ro);
+    self->ro = ro;
+    self->slot_cells = rhc_realloc_raising(self->slot_cells, self->ro.num * sizeof(int));
+
+    // new vbo
+    self->update_begin = 0;
+    self->update_end = self->size;
+}
+
+static int layer_add_slot(Layer *self, int cell) {
+    if (self->size >= self->ro.num)
+        layer_grow(self);
+
+    int slot = self->size++;
+    self->cell_slots[cell] = slot;
+    self->slot_cells[slot] = cell;
+
+    int c = cell % L.image.cols;
+    int r = cell / L.image.cols;
     float w = 1.0 / L.image.cols;
     float h = 1.0 / L.image.rows;
-    *ro = ro_batch_new(L.image.cols * L.image.rows, &L.mvp.m00, tex);
-    ro->owns_tex = false; // tiles.h owns it
+    self->ro.rects[slot].xy = (vec2) {{-0.5 + (c + 0.5) * w, 0.5 - (r + 0.5) * h}};
+    self->ro.rects[slot].size = (vec2) {{w, h}};
+    return slot;
+}
 
-    for (int r = 0; r < L.image.rows; r++) {
-        for (int c = 0; c < L.image.cols; c++) {
-            ro->rects[r * L.image.cols + c].pose = u_pose_new_aa(-0.5 + c * w, 0.5 - r * h, w, h);
+// moves the last slot into the removed one
+static void layer_remove_slot(Layer *self, int cell) {
+    int slot = self->cell_slots[cell];
+    int last = --self->size;
+    self->cell_slots[cell] = -1;
+    if (slot == last)
+        return;
+
+    self->ro.rects[slot] = self->ro.rects[last];
+    self->slot_cells[slot] = self->slot_cells[last];
+    self->cell_slots[self->slot_cells[slot]] = slot;
+    layer_mark_update(self, slot);
+}
+
+static void layer_clear(Layer *self) {
+    for (int i = 0; i < self->size; i++)
+        self->cell_slots[self->slot_cells[i]] = -1;
+    self->size = 0;
+}
+
+static void layer_update(Layer *self) {
+    if (self->update_end <= self->update_begin)
+        return;
+    // the removed slots at the end must not be uploaded
+    if (self->update_end > self->size)
+        self->update_end = self->size;
+    if (self->update_end > self->update_begin)
+        ro_batch2d_update_sub(&self->ro, self->update_begin, self->update_end - self->update_begin);
+    self->update_begin = INT_MAX;
+    self->update_end = 0;
+}
+
+static void init_render_objects() {
+    L.use_tilemap = L.image.cols <= r_render.max_texture_size
+                    && L.image.rows <= r_render.max_texture_size;
+    log_info("canvas: render layers as %s", L.use_tilemap ? "tilemap" : "batch");
+
+    for (int layer = 0; layer < L.image.layers; layer++) {
+        if (L.use_tilemap) {
+            L.layers[layer].map = ro_tilemap_new(L.image.cols, L.image.rows,
+                                                 (ivec2) {{TILES_COLS, TILES_ROWS}},
+                                                 &L.mvp.m00, tiles.sheets);
+            L.layers[layer].map.owns_tex = false; // tiles.h owns it
+            L.layers[layer].map.slots = tiles.slots;
+        } else {
+            layer_init(&L.layers[layer]);
         }
     }
 }
 
-static void init_render_objects() {
+// adds the tile sheets used in the region (all layers) to the view sheets
+static void add_view_sheets(Region r) {
+    if (region_empty(r))
+        return;
+    bool used[MAX_TILES + 1] = {0};
+    for (int i = 0; i < L.view_sheets_size; i++)
+        used[L.view_sheets[i]] = true;
     for (int layer = 0; layer < L.image.layers; layer++) {
-        for (int i = 0; i < tiles.size; i++) {
-            init_tile_ro(&L.tiles[layer][i], tiles.textures[i]);
+        for (int row = r.top; row < r.bottom; row++) {
+            uColor_s *it = u_image_pixel(L.image, r.left, row, layer);
+            for (int c = r.left; c < r.right; c++, it++) {
+                int id = it->b;
+                if (id > 0 && id <= tiles.size && !used[id]) {
+                    used[id] = true;
+                    L.view_sheets[L.view_sheets_size++] = id;
+                }
+            }
         }
     }
 }
 
-static mat4 pixel_pose(int x, int y) {
-    float w = u_pose_get_w(L.pose);
-    float size = w / L.image.cols;
+static void render_layer(int layer) {
+    if (L.use_tilemap)
+        ro_tilemap_render(&L.layers[layer].map);
+    else if (L.layers[layer].size > 0)
+        ro_batch2d_render_sub(&L.layers[layer].ro, L.layers[layer].size);
+}
 
+// renders the layers below the current layer into the cache framebuffer
+static void render_cache() {
+    Region v = L.view;
+    float px = L.view_px;
+    int cols = (int) ceilf((v.right - v.left) * px);
+    int rows = (int) ceilf((v.bottom - v.top) * px);
+    cols = cols < 1 ? 1 : (cols > r_render.max_texture_size ? r_render.max_texture_size : cols);
+    rows = rows < 1 ? 1 : (rows > r_render.max_texture_size ? r_render.max_texture_size : rows);
+
+    if (L.cache_fb.tex.sprite_size.x != cols || L.cache_fb.tex.sprite_size.y != rows) {
+        r_framebuffer_kill(&L.cache_fb);
+        L.cache_fb = r_framebuffer_new(cols, rows);
+        ro_single_set_texture(&L.cache, L.cache_fb.tex);
+    }
+    if (!r_framebuffer_valid(L.cache_fb))
+        return;
+
+    float left = -0.5f + (float) v.left / L.image.cols;
+    float right = -0.5f + (float) v.right / L.image.cols;
+    float top = 0.5f - (float) v.top / L.image.rows;
+    float bottom = 0.5f - (float) v.bottom / L.image.rows;
+
+    // the layers use L.mvp, top and bottom are flipped, so that the framebuffer rows
+    // match the texture coords of RoSingle
+    mat4 mvp = L.mvp;
+    L.mvp = mat4_camera_ortho(left, right, top, bottom, -1, 1);
+
+    r_framebuffer_begin(L.cache_fb);
+    for (int layer = 0; layer < canvas.current_layer; layer++)
+        render_layer(layer);
+    r_framebuffer_end();
+
+    L.mvp = mvp;
+    L.cache.rect.pose = u_pose_new_aa(left, top, right - left, top - bottom);
+    L.cache_valid = true;
+}
 
-    float pos_x = u_pose_aa_get_left(L.pose) + (x + 0.5f) * size;
-    float pos_y = u_pose_aa_get_top(L.pose) - (y + 0.5f) * size;
+static void set_pixel_rect(rRect2d_s *rect, int x, int y, int sprite_x, int sprite_y) {
+    float w = u_pose_get_w(L.pose);
+    float size = w / L.image.cols;
 
-    mat4 pose = mat4_eye();
-    u_pose_set(&pose, pos_x, pos_y, size, size, 0);
-    return pose;
+    rect->xy.x = u_pose_aa_get_left(L.pose) + (x + 0.5f) * size;
+    rect->xy.y = u_pose_aa_get_top(L.pose) - (y + 0.5f) * size;
+    rect->size = vec2_set(size);
+    rect->sprite.x = sprite_x;
+    rect->sprite.y = sprite_y;
 }
 
 static void setup_selection() {
@@ -90,100 +436,269 @@ static void setup_selection() {
 
     int idx = 0;
     for (int i = 0; i < h; i++) {
-        L.selection_border.rects[idx].pose = pixel_pose(x - 1, y + i);
-        L.selection_border.rects[idx].sprite = (vec2) {0, 0};
+        set_pixel_rect(&L.selection_border.rects[idx], x - 1, y + i, 0, 0);
         idx++;
         if (idx >= max) goto UPDATE;
 
-        L.selection_border.rects[idx].pose = pixel_pose(x + w, y + i);
-        L.selection_border.rects[idx].sprite = (vec2) {0, 1};
+        set_pixel_rect(&L.selection_border.rects[idx], x + w, y + i, 0, 1);
         idx++;
         if (idx >= max) goto UPDATE;
     }
     for (int i = 0; i < w; i++) {
-        L.selection_border.rects[idx].pose = pixel_pose(x + i, y - 1);
-        L.selection_border.rects[idx].sprite = (vec2) {1, 0};
+        set_pixel_rect(&L.selection_border.rects[idx], x + i, y - 1, 1, 0);
         idx++;
         if (idx >= max) goto UPDATE;
 
-        L.selection_border.rects[idx].pose = pixel_pose(x + i, y + h);
-        L.selection_border.rects[idx].sprite = (vec2) {1, 1};
+        set_pixel_rect(&L.selection_border.rects[idx], x + i, y + h, 1, 1);
         idx++;
         if (idx >= max) goto UPDATE;
     }
 
     for (; idx < L.selection_border.num; idx++) {
-        u_pose_set(&L.selection_border.rects[idx].pose, FLT_MAX, FLT_MAX, 0, 0, 0);
+        L.selection_border.rects[idx].xy = vec2_set(FLT_MAX);
     }
 
     UPDATE:
-    ro_batch_update(&L.selection_border);
+    ro_batch2d_update(&L.selection_border);
 }
 
 
 static void set_pixel_tile(int layer, int c, int r) {
-
-    for (int i = 0; i < tiles.size; i++) {
-        int idx = r * L.image.cols + c;
-        L.tiles[layer][i].rects[idx].color.a = 0;
-    }
+    Layer *self = &L.layers[layer];
+    int cell = r * L.image.cols + c;
+    int slot = self->cell_slots[cell];
 
     uColor_s code = *u_image_pixel(L.image, c, r, layer);
 
     int tile_id = code.b;
+    int sheet_slot = tiles_slot(tile_id);
+
+    if (tile_id <= 0 || tile_id > tiles.size || sheet_slot < 0
+        || !region_contains(L.view, c, r)) {
+        if (slot >= 0)
+            layer_remove_slot(self, cell);
+        return;
+    }
+
+    if (slot < 0)
+        slot = layer_add_slot(self, cell);
 
-    if (layer <= canvas.current_layer && tile_id > 0 && tile_id <= tiles.size) {
-        tile_id--;
+    rRect2d_s *rect = &self->ro.rects[slot];
 
-        vec4 color = (vec4) {{1, 1, 1, (float) layer / canvas.current_layer}};
+    // sheet as texture layer, tile as uv in that sheet
+    int tile_x = code.a % TILES_COLS;
+    int tile_y = code.a / TILES_COLS;
+    rect->sprite.x = 0;
+    rect->sprite.y = sheet_slot;
+    rect->uv_xy = (vec2) {{(float) tile_x / TILES_COLS, (float) tile_y / TILES_ROWS}};
+    rect->uv_size = (vec2) {{1.0f / TILES_COLS, 1.0f / TILES_ROWS}};
 
-        int tile_x = code.a % TILES_COLS;
-        int tile_y = code.a / TILES_COLS;
+    float alpha = (layer + 1.0) / (canvas.current_layer + 1.0);
+    rect->color.a = (unsigned char) (alpha * canvas.alpha * 255 + 0.5f);
+
+    layer_mark_update(self, slot);
+}
 
-        int idx = r * L.image.cols + c;
-        L.tiles[layer][tile_id].rects[idx].sprite = (vec2) {{tile_x, tile_y}};
 
-        float alpha = (layer + 1.0) / (canvas.current_layer + 1.0);
-        L.tiles[layer][tile_id].rects[idx].color.a = alpha * canvas.alpha;
+// writes the changed chunks of the tilemap file.
+// An export writes the png into a temp file and renames it, so the file is never half written.
+// The tilemap file is written afterwards (also if nothing changed), so it is newer, if both are up to date
+static void write_image_file(uImage img, Region changed, uint64_t tag, bool export_png) {
+    if (export_png) {
+        char tmp_file[256];
+        snprintf(tmp_file, sizeof tmp_file, "%s.tmp", canvas.default_image_file);
+        if (u_image_save_file(img, tmp_file) && rename(tmp_file, canvas.default_image_file) != 0)
+            log_error("canvas: failed to rename the image file: %s", canvas.default_image_file);
     }
 
+    if (export_png || !region_empty(changed)) {
+        if (region_empty(changed))
+            changed = (Region) {0};
+        u_tilemap_save_file_region(img, L.tilemap_file, changed.left, changed.top,
+                                   changed.right - changed.left, changed.bottom - changed.top, tag);
+    }
+}
+
+// the tilemap file is used, if its not older than the png file (which may be edited by other tools)
+static bool load_tilemap_file() {
+    struct stat tilemap_st, png_st;
+    if (stat(L.tilemap_file, &tilemap_st) != 0)
+        return false;
+    bool has_png = stat(canvas.default_image_file, &png_st) == 0;
+    if (has_png && png_st.st_mtime > tilemap_st.st_mtime) {
+        log_info("canvas: png file is newer than the tilemap file");
+        return false;
+    }
+    // an export writes the tilemap file right after the png, else the png misses saves (of a crash)
+    L.png_outdated = !has_png || png_st.st_mtime + 2 < tilemap_st.st_mtime;
+    return u_tilemap_load_file(L.image, L.tilemap_file, &L.file_generation);
+}
+
+static int autosave_thread(void *arg) {
+    SDL_LockMutex(L.autosave.lock);
+    for (;;) {
+        while (!u_image_valid(L.autosave.pending))
+            SDL_CondWait(L.autosave.cond, L.autosave.lock);
+
+        uImage img = L.autosave.pending;
+        Region changed = L.autosave.pending_region;
+        uint64_t tag = L.autosave.pending_tag;
+        bool export_png = L.autosave.pending_export;
+        L.autosave.pending = u_image_new_invalid();
+        L.autosave.pending_export = false;
+        L.autosave.pending_region = region_new_empty();
+        L.autosave.busy = true;
+        SDL_UnlockMutex(L.autosave.lock);
+
+        write_image_file(img, changed, tag, export_png);
+
+        SDL_LockMutex(L.autosave.lock);
+        L.autosave.busy = false;
+        if (!u_image_valid(L.autosave.spare))
+            L.autosave.spare = img;
+        else
+            u_image_kill(&img);
+        SDL_CondBroadcast(L.autosave.cond);
+    }
+    return 0;
+}
 
+static void autosave_init() {
+    L.autosave.pending = u_image_new_invalid();
+    L.autosave.spare = u_image_new_invalid();
+    L.autosave.pending_region = region_new_empty();
+    L.autosave.lock = SDL_CreateMutex();
+    L.autosave.cond = SDL_CreateCond();
+    if (L.autosave.lock && L.autosave.cond)
+        L.autosave.thread = SDL_CreateThread(autosave_thread, "canvas autosave", NULL);
+    if (!L.autosave.thread)
+        log_warn("canvas: no autosave thread, saving synchronously");
 }
 
+// hands a snapshot of the image to the writer thread, pending snapshots are replaced
+// the tilemap file is tagged with the current savestate generation
+static void save_image(Region changed, bool export_png) {
+    changed = region_union(changed, L.unwritten);
+    L.unwritten = region_new_empty();
+    if (!region_empty(changed))
+        L.png_outdated = true;
+    if (export_png) {
+        L.png_outdated = false;
+        L.png_time = 0;
+    }
+    if (!L.autosave.thread) {
+        write_image_file(L.image, changed, savestate_generation(), export_png);
+        return;
+    }
+    SDL_LockMutex(L.autosave.lock);
+    L.autosave.pending_region = region_union(L.autosave.pending_region, changed);
+    L.autosave.pending_tag = savestate_generation();
+    L.autosave.pending_export |= export_png;
+    if (!u_image_valid(L.autosave.pending)) {
+        L.autosave.pending = L.autosave.spare;
+        L.autosave.spare = u_image_new_invalid();
+    }
+    if (u_image_valid(L.autosave.pending))
+        u_image_copy(L.autosave.pending, L.image);
+    else
+        L.autosave.pending = u_image_new_clone(L.image);
+    SDL_CondBroadcast(L.autosave.cond);
+    SDL_UnlockMutex(L.autosave.lock);
+}
 
 static void save_state() {
-    log_info("canvas: save_state");
-    
-    // costum uImage with data concatenated
-    size_t img_size = sizeof(uImage) + u_image_data_size(L.image);
-    char *data = rhc_malloc_raising(img_size);
-    uImage *img = (uImage *) data;
-    img->data = (uColor_s *) (data + sizeof(uImage));
-    img->cols = L.image.cols;
-    img->rows = L.image.rows;
-    img->layers = L.image.layers;
-    img->allocator = allocator_new_empty_raising();
-    
-    u_image_copy(*img, L.image);
-    savestate_save_data(img, img_size);
-    
-    // costum uImage
-    rhc_free(img);
-}
-
-static void load_state(const void *data, size_t size) {
-    log_info("canvas: load_state");
-    // todo: check new layers, rows, cols
-    assume(sizeof(uImage) + u_image_data_size(L.image) == size, "invalid data + size pair");
-    
-    u_image_kill(&L.image);
-    
-    // costum uImage with data concatenated
-    uImage *img = (uImage *) data;
-    img->data = (uColor_s *) ((char*) data + sizeof(uImage));
-    
-    L.image = u_image_new_clone(*img);
-    u_image_save_file(canvas_image(), canvas.default_image_file);
+    // prev_image is still the last saved state
+    Region r = L.unsaved;
+    bool full = savestate_saving_full();
+    if (full)
+        r = (Region) {0, 0, L.image.cols, L.image.rows};
+    int cols = 0, rows = 0;
+    if (!region_empty(r)) {
+        cols = r.right - r.left;
+        rows = r.bottom - r.top;
+    } else
+        r = (Region) {0};
+    log_info("canvas: save_state: %i x %i", cols, rows);
+
+    size_t n = (size_t) cols * rows * L.image.layers;
+    size_t size = sizeof(Delta) + (full ? 1 : 2) * n * sizeof(uColor_s);
+    Delta *delta = rhc_malloc_raising(size);
+    delta->region = r;
+    delta->has_prev = !full;
+
+    // a full record is the last saved state, without the unsaved changes
+    uImage post = full ? L.prev_image : L.image;
+    uColor_s *it = delta->data;
+    for (int pass = full ? 1 : 0; pass < 2; pass++) {
+        uImage img = pass == 0 ? L.prev_image : post;
+        for (int layer = 0; layer < L.image.layers; layer++) {
+            for (int row = r.top; row < r.bottom; row++) {
+                memcpy(it, u_image_pixel(img, r.left, row, layer), cols * sizeof(uColor_s));
+                it += cols;
+            }
+        }
+    }
+
+    savestate_save_data(delta, size);
+    rhc_free(delta);
+}
+
+// returns the checked region of a delta, or an empty region
+static Region delta_region(const void *data, size_t size) {
+    assume(size >= sizeof(Delta), "invalid data + size pair");
+    const Delta *delta = data;
+    Region r = delta->region;
+    if (region_empty(r))
+        return region_new_empty();
+
+    size_t n = (size_t) (r.right - r.left) * (r.bottom - r.top) * L.image.layers;
+    assume(size == sizeof(Delta) + (delta->has_prev ? 2 : 1) * n * sizeof(uColor_s)
+           && region_contains_region((Region) {0, 0, L.image.cols, L.image.rows}, r),
+           "invalid data + size pair");
+    return r;
+}
+
+// writes pixels of a region into image and prev_image
+static void delta_apply(Region r, const uColor_s *it) {
+    int cols = r.right - r.left;
+    for (int layer = 0; layer < L.image.layers; layer++) {
+        for (int row = r.top; row < r.bottom; row++) {
+            memcpy(u_image_pixel(L.image, r.left, row, layer), it, cols * sizeof(uColor_s));
+            memcpy(u_image_pixel(L.prev_image, r.left, row, layer), it, cols * sizeof(uColor_s));
+            it += cols;
+        }
+    }
+    mark_changed(r);
+    L.cache_valid = false;
+}
+
+static void undo_state(const void *data, size_t size) {
+    log_info("canvas: undo_state");
+    Region r = delta_region(data, size);
+    if (region_empty(r))
+        return;
+    const Delta *delta = data;
+    assume(delta->has_prev, "full state can not be undone");
+
+    // drop unsaved changes, as a full state load would
+    canvas_redo_image();
+
+    delta_apply(r, delta->data);
+    save_image(r, false);
+}
+
+// applies the new pixels of a delta (from the journal), the files are written in canvas_update
+static void redo_state(const void *data, size_t size) {
+    Region r = delta_region(data, size);
+    if (region_empty(r))
+        return;
+    const Delta *delta = data;
+    size_t n = (size_t) (r.right - r.left) * (r.bottom - r.top) * L.image.layers;
+
+    canvas_redo_image();
+
+    delta_apply(r, delta->has_prev ? delta->data + n : delta->data);
+    L.unwritten = region_union(L.unwritten, r);
 }
 
 
@@ -196,7 +711,8 @@ void canvas_init(int cols, int rows, int layers, int grid_cols, int grid_rows) {
     assume(layers <= MAX_LAYERS, "too many layers");
     canvas.alpha = 1.0;
 
-    L.save_id = savestate_register(save_state, load_state);
+    L.save_id = savestate_register_delta(save_state, undo_state, redo_state);
+    autosave_init();
 
     L.pose = mat4_eye();
     L.mvp = mat4_eye();
@@ -205,17 +721,32 @@ void canvas_init(int cols, int rows, int layers, int grid_cols, int grid_rows) {
     L.image = u_image_new_zeros(cols, rows, layers);
     canvas.current_layer = layers>=2? 1 : 0;
 
+    L.dirty = region_new_empty();
+    L.unsaved = region_new_empty();
+    L.unwritten = region_new_empty();
+    L.file_generation = 0;
+    L.changed = region_new_empty();
+    L.generation = 0;
+    L.view = region_new_empty();
+    L.view_px = 0;
+    L.last_layer = -1;
+
     init_render_objects();
 
+    L.cache_fb = r_framebuffer_new_invalid();
+    L.cache = ro_single_new(&L.mvp.m00, L.cache_fb.tex);
+    L.cache.owns_tex = false; // L.cache_fb owns it
+    L.cache_valid = false;
+
     L.grid = ro_single_new(canvascam.gl,
                      r_texture_new_file(1, 1, "res/canvas_grid.png"));
     u_pose_set_size(&L.grid.rect.uv, cols, rows);
 
 
-    L.selection_border = ro_batch_new(2 * (rows + cols) * SELECTION_BORDER_FACTOR, canvascam.gl,
+    L.selection_border = ro_batch2d_new(2 * (rows + cols) * SELECTION_BORDER_FACTOR, canvascam.gl,
                     r_texture_new_file(2, 2, "res/selection_border.png"));
     for (int i = 0; i < L.selection_border.num; i++) {
-        L.selection_border.rects[i].color = u_color_to_vec4(u_color_from_hex("#357985"));
+        L.selection_border.rects[i].color = u_color_from_hex("#357985");
     }
 
 
@@ -230,13 +761,31 @@ void canvas_init(int cols, int rows, int layers, int grid_cols, int grid_rows) {
         u_pose_set_size(&L.bg.rect.uv, w, h);
     }
 
-    uImage img = u_image_new_file(layers, canvas.default_image_file);
-    if (u_image_valid(img)) {
-        u_image_copy(L.image, img);
-        u_image_kill(&img);
+    // tilemap.png -> tilemap.tilemap
+    snprintf(L.tilemap_file, sizeof L.tilemap_file, "%s", canvas.default_image_file);
+    char *ext = strrchr(L.tilemap_file, '.');
+    if (ext && strcmp(ext, ".png") == 0)
+        *ext = '\0';
+    strncat(L.tilemap_file, ".tilemap", sizeof L.tilemap_file - strlen(L.tilemap_file) - 1);
+
+    if (load_tilemap_file()) {
+        log_info("canvas: loaded %s", L.tilemap_file);
+    } else {
+        uImage img = u_image_new_file(layers, canvas.default_image_file);
+        if (u_image_valid(img)) {
+            u_image_copy(L.image, img);
+            u_image_kill(&img);
+        }
+        // outdated, the next save writes it completely
+        remove(L.tilemap_file);
+        L.file_generation = 0;
+        L.png_outdated = false;
     }
 
     L.prev_image = u_image_new_clone(L.image);
+    canvas_mark_dirty(0, 0, cols, rows);
+    // equal to prev_image, the first state needs no delta
+    L.unsaved = region_new_empty();
 }
 
 void canvas_update(float dtime) {
@@ -259,15 +808,85 @@ void canvas_update(float dtime) {
 
     L.mvp = mat4_mul_mat(Mat4(canvascam.gl), L.pose);
 
-    for (int layer = 0; layer <= canvas.current_layer; layer++) {
-        for (int r = 0; r < L.image.rows; r++) {
-            for (int c = 0; c < L.image.cols; c++) {
-                set_pixel_tile(layer, c, r);
-            }
+    // the view only changes on zoom, or if the visible cells leave it
+    Region view = L.view;
+    Region visible = visible_region();
+    float px = cell_pixels();
+    bool zoom_changed = px != L.view_px;
+    if (zoom_changed || !region_contains_region(L.view, visible)) {
+        view = view_region(visible);
+        L.view_px = px;
+    }
+    // cells of the previous and the new view (needed to remove rects that left the view)
+    Region cull = region_union(view, L.view);
+    bool view_changed = !region_equals(view, L.view);
+    L.view = view;
+
+    // the current layer is not in the cache
+    if (zoom_changed || view_changed
+        || canvas.current_layer != L.last_layer || canvas.alpha != L.last_alpha)
+        L.cache_valid = false;
+
+    if (L.use_tilemap) {
+        // render only the visible part of the map
+        float w = (float) (view.right - view.left) / L.image.cols;
+        float h = (float) (view.bottom - view.top) / L.image.rows;
+        float left = (float) view.left / L.image.cols;
+        float top = (float) view.top / L.image.rows;
+        for (int layer = 0; layer <= canvas.current_layer; layer++) {
+            RoTilemap *map = &L.layers[layer].map;
+            float alpha = (layer + 1.0) / (canvas.current_layer + 1.0);
+            map->color.a = alpha * canvas.alpha;
+            map->pose = u_pose_new_aa(-0.5 + left, 0.5 - top, w, h);
+            u_pose_set(&map->uv, left, top, w, h, 0);
         }
+    } else if (canvas.current_layer != L.last_layer || canvas.alpha != L.last_alpha) {
+        // the rect alpha depends on the current layer, so rebuild the view
+        for (int layer = 0; layer < L.image.layers; layer++)
+            layer_clear(&L.layers[layer]);
+        L.dirty = region_union(L.dirty, view);
+    } else if (view_changed) {
+        L.dirty = region_union(L.dirty, cull);
+    }
+    L.last_layer = canvas.current_layer;
+    L.last_alpha = canvas.alpha;
 
-        for (int i = 0; i < tiles.size; i++) {
-            ro_batch_update(&L.tiles[layer][i]);
+    if (view_changed) {
+        L.view_sheets_size = 0;
+        add_view_sheets(view);
+    }
+    add_view_sheets(region_intersection(L.dirty, view));
+    tiles_require(L.view_sheets, L.view_sheets_size);
+
+    // view sheets are only evicted by a lowered memory budget, the rects of the batches need a rebuild
+    // (the tilemap looks the slots up while rendering)
+    if (tiles.evictions != L.tiles_evictions) {
+        L.tiles_evictions = tiles.evictions;
+        if (!L.use_tilemap)
+            L.dirty = region_union(L.dirty, view);
+    }
+
+    if (L.use_tilemap && !region_empty(L.dirty)) {
+        Region d = L.dirty;
+        L.dirty = region_new_empty();
+
+        // all layers, so a layer switch needs no upload
+        for (int layer = 0; layer < L.image.layers; layer++) {
+            ro_tilemap_set_sub(&L.layers[layer].map, u_image_layer(L.image, layer),
+                               d.left, d.top, d.right - d.left, d.bottom - d.top);
+        }
+    } else if (!region_empty(L.dirty)) {
+        // cells outside of both views are not in the render lists
+        Region d = region_intersection(L.dirty, cull);
+        L.dirty = region_new_empty();
+
+        for (int layer = 0; layer <= canvas.current_layer; layer++) {
+            for (int r = d.top; r < d.bottom; r++) {
+                for (int c = d.left; c < d.right; c++) {
+                    set_pixel_tile(layer, c, r);
+                }
+            }
+            layer_update(&L.layers[layer]);
         }
     }
 
@@ -275,22 +894,46 @@ void canvas_update(float dtime) {
     L.bg.rect.pose = L.pose;
 
     setup_selection();
+
+    if (!region_empty(L.unwritten))
+        save_image(region_new_empty(), false);
+
+    L.png_time += dtime;
+    if (L.png_outdated && L.png_time >= PNG_EXPORT_INTERVAL)
+        canvas_export();
+
+    if (!region_empty(L.changed)) {
+        L.generation++;
+        L.history[L.generation % CHANGE_HISTORY] = L.changed;
+        L.changed = region_new_empty();
+    }
 }
 
 void canvas_render() {
     ro_single_render(&L.bg);
 
-    for (int layer = 0; layer <= canvas.current_layer; layer++) {
-        for (int i = 0; i < tiles.size; i++) {
-            ro_batch_render(&L.tiles[layer][i]);
+    if (!region_empty(L.view)) {
+        if (canvas.current_layer > 0 && !L.cache_valid)
+            render_cache();
+
+        if (L.cache_valid) {
+            // inactive layers in a single quad
+            r_render_blend_premultiplied(true);
+            ro_single_render(&L.cache);
+            r_render_blend_premultiplied(false);
+        } else {
+            // fallback, if the framebuffer is not available
+            for (int layer = 0; layer < canvas.current_layer; layer++)
+                render_layer(layer);
         }
+        render_layer(canvas.current_layer);
     }
 
     if (canvas.show_grid)
         ro_single_render(&L.grid);
 
     if (selection_active())
-        ro_batch_render(&L.selection_border);
+        ro_batch2d_render(&L.selection_border);
 }
 
 
@@ -313,6 +956,39 @@ ivec2 canvas_get_cr(vec4 pointer_pos) {
     return cr;
 }
 
+void canvas_mark_dirty(int left, int top, int cols, int rows) {
+    Region r = {
+            left < 0 ? 0 : left,
+            top < 0 ? 0 : top,
+            left + cols > L.image.cols ? L.image.cols : left + cols,
+            top + rows > L.image.rows ? L.image.rows : top + rows
+    };
+    if (region_empty(r))
+        return;
+    mark_changed(r);
+    L.unsaved = region_union(L.unsaved, r);
+}
+
+int canvas_generation() {
+    return L.generation;
+}
+
+bool canvas_changed_since(int generation, int *out_left, int *out_top, int *out_cols, int *out_rows) {
+    if (generation >= L.generation)
+        return false;
+    Region r = {0, 0, L.image.cols, L.image.rows};
+    if (L.generation - generation <= CHANGE_HISTORY) {
+        r = region_new_empty();
+        for (int g = generation + 1; g <= L.generation; g++)
+            r = region_union(r, L.history[g % CHANGE_HISTORY]);
+    }
+    *out_left = r.left;
+    *out_top = r.top;
+    *out_cols = r.right - r.left;
+    *out_rows = r.bottom - r.top;
+    return true;
+}
+
 void canvas_clear() {
     for (int r = 0; r < L.image.rows; r++) {
         for (int c = 0; c < L.image.cols; c++) {
@@ -322,18 +998,52 @@ void canvas_clear() {
             *u_image_pixel(L.image, c, r, canvas.current_layer) = U_COLOR_TRANSPARENT;
         }
     }
+    if (selection_active())
+        canvas_mark_dirty(selection_pos().x, selection_pos().y, selection_size().x, selection_size().y);
+    else
+        canvas_mark_dirty(0, 0, L.image.cols, L.image.rows);
     canvas_save();
 }
 
 void canvas_save() {
-    if (!u_image_equals(L.image, L.prev_image)) {
-        u_image_copy(L.prev_image, L.image);
-        savestate_save();
-        u_image_save_file(canvas_image(), canvas.default_image_file);
+    // only the unsaved changes may differ from the previous image
+    Region r = L.unsaved;
+    if (region_empty(r) || region_image_equals(L.image, L.prev_image, r)) {
+        L.unsaved = region_new_empty();
+        return;
     }
+
+    // save_state stores the previous pixels of L.unsaved
+    savestate_save();
+    region_copy(L.prev_image, L.image, r);
+    L.unsaved = region_new_empty();
+    save_image(r, false);
 }
 
-void canvas_redo_image() {
-    u_image_copy(L.image, L.prev_image);
+uint64_t canvas_file_generation() {
+    return L.file_generation;
+}
+
+void canvas_export() {
+    save_image(region_new_empty(), true);
+}
+
+void canvas_save_flush() {
+    if (L.png_outdated)
+        canvas_export();
+    if (!L.autosave.thread)
+        return;
+    SDL_LockMutex(L.autosave.lock);
+    while (u_image_valid(L.autosave.pending) || L.autosave.busy)
+        SDL_CondWait(L.autosave.cond, L.autosave.lock);
+    SDL_UnlockMutex(L.autosave.lock);
 }
 
+void canvas_redo_image() {
+    // only the unsaved changes differ from the previous image
+    if (!region_empty(L.unsaved)) {
+        region_copy(L.image, L.prev_image, L.unsaved);
+        mark_changed(L.unsaved);
+    }
+    L.unsaved = region_new_empty();
+}
@@ -25,21 +25,31 @@ typedef struct {
     void *ud;
 } RegWheel;
 
+// samples of a pointer, collected during a frame
+typedef struct {
+    ePointerSample_s samples[E_MAX_POINTER_SAMPLES];
+    int size;
+} Motion;
+
 static struct {
     RegPointer reg_pointer_e[E_MAX_POINTER_EVENTS];
     int reg_pointer_e_size;
 
+    Motion motions[E_MAX_POINTERS];
+
+    // samples of the event in emission
+    const ePointerSample_s *history;
+    int history_size;
+
     RegWheel reg_wheel_e[E_MAX_WHEEL_EVENTS];
     int reg_wheel_e_size;
 
 } L;
 
-static ePointer_s pointer_mouse(enum ePointerAction action, int btn_id) {
+static ePointer_s pointer_mouse(enum ePointerAction action, int x, int y, int btn_id) {
     ePointer_s res;
     res.action = action;
     res.id = btn_id;
-    int x, y;
-    SDL_GetMouseState(&x, &y);
 
     res.pos.x = (2.0f * x) / e_window.size.x - 1.0f;
     res.pos.y = 1.0f - (2.0f * y) / e_window.size.y;
@@ -62,9 +72,54 @@ static ePointer_s pointer_finger(enum ePointerAction action, float x, float y, i
     return res;
 }
 
-static void emit_pointer_events(ePointer_s action) {
+// emits the last sample, the others are available as history
+static void emit_pointer_samples(const ePointerSample_s *samples, int size) {
+    L.history = samples;
+    L.history_size = size;
+    ePointer_s action = samples[size - 1].pointer;
     for (int i = 0; i < L.reg_pointer_e_size; i++)
         L.reg_pointer_e[i].cb(action, L.reg_pointer_e[i].ud);
+    L.history = NULL;
+    L.history_size = 0;
+}
+
+static void flush_motions() {
+    for (int i = 0; i < E_MAX_POINTERS; i++) {
+        Motion *m = &L.motions[i];
+        if (m->size == 0)
+            continue;
+        emit_pointer_samples(m->samples, m->size);
+        m->size = 0;
+    }
+}
+
+static void emit_pointer_events(ePointer_s action, uint32_t time) {
+    ePointerSample_s sample = {action, time};
+    if (action.action != E_POINTER_MOVE) {
+        // keep the order of moves and downs / ups
+        flush_motions();
+        emit_pointer_samples(&sample, 1);
+        return;
+    }
+
+    Motion *m = NULL;
+    for (int i = 0; i < E_MAX_POINTERS && !m; i++) {
+        if (L.motions[i].size > 0 && L.motions[i].samples[0].pointer.id == action.id)
+            m = &L.motions[i];
+    }
+    for (int i = 0; i < E_MAX_POINTERS && !m; i++) {
+        if (L.motions[i].size == 0)
+            m = &L.motions[i];
+    }
+    if (!m) {
+        flush_motions();
+        m = &L.motions[0];
+    }
+    if (m->size >= E_MAX_POINTER_SAMPLES) {
+        emit_pointer_samples(m->samples, m->size);
+        m->size = 0;
+    }
+    m->samples[m->size++] = sample;
 }
 
 static void emit_wheel_events(bool up) {
@@ -76,15 +131,18 @@ static void input_handle_pointer_touch(SDL_Event *event) {
     switch (event->type) {
     case SDL_FINGERDOWN:
         emit_pointer_events(pointer_finger(E_POINTER_DOWN,
-                                           event->tfinger.x, event->tfinger.y, event->tfinger.fingerId));
+                                           event->tfinger.x, event->tfinger.y, event->tfinger.fingerId),
+                            event->tfinger.timestamp);
         break;
     case SDL_FINGERMOTION:
         emit_pointer_events(pointer_finger(E_POINTER_MOVE,
-                                           event->tfinger.x, event->tfinger.y, event->tfinger.fingerId));
+                                           event->tfinger.x, event->tfinger.y, event->tfinger.fingerId),
+                            event->tfinger.timestamp);
         break;
     case SDL_FINGERUP:
         emit_pointer_events(pointer_finger(E_POINTER_UP,
-                                           event->tfinger.x, event->tfinger.y, event->tfinger.fingerId));
+                                           event->tfinger.x, event->tfinger.y, event->tfinger.fingerId),
+                            event->tfinger.timestamp);
         break;
     }
 }
@@ -95,18 +153,19 @@ static void input_handle_pointer_mouse(SDL_Event *event) {
         if (event->button.button <= 0 || event->button.button > 3)
             break;
         emit_pointer_events(pointer_mouse(
-            E_POINTER_DOWN,
-            1 - event->button.button));
+            E_POINTER_DOWN, event->button.x, event->button.y,
+            1 - event->button.button), event->button.timestamp);
         break;
     case SDL_MOUSEMOTION:
-        emit_pointer_events(pointer_mouse(E_POINTER_MOVE, 0));
+        emit_pointer_events(pointer_mouse(E_POINTER_MOVE, event->motion.x, event->motion.y, 0),
+                            event->motion.timestamp);
         break;
     case SDL_MOUSEBUTTONUP:
         if (event->button.button <= 0 || event->button.button > 3)
             break;
         emit_pointer_events(pointer_mouse(
-            E_POINTER_UP,
-            1 - event->button.button));
+            E_POINTER_UP, event->button.x, event->button.y,
+            1 - event->button.button), event->button.timestamp);
         break;
     }
 }
@@ -224,10 +283,18 @@ void e_input_update() {
         }
     }
 
+    // a single move per pointer and frame
+    flush_motions();
+
     if (e_gui.ctx)
         nk_input_end(e_gui.ctx);
 }
 
+const ePointerSample_s *e_input_pointer_history(int *out_size) {
+    *out_size = L.history_size;
+    return L.history;
+}
+
 void e_input_register_pointer_event(ePointerEventFn event, void *user_data) {
     assume(L.reg_pointer_e_size < E_MAX_POINTER_EVENTS, "too many registered pointer events");
     L.reg_pointer_e[L.reg_pointer_e_size++] = (RegPointer){event, user_data};
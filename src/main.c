@@ -47,6 +47,9 @@
 // #define IMAGE_FILE "../JumpHare/res/levels/level_01.png"
 // #define IMPORT_FILE "res/color_drop.png"
 
+// uncomment to keep the undo history in a journal file (restored on startup):
+// #define JOURNAL_FILE "tilemap.journal"
+
 //
 // end of options
 //
@@ -87,12 +90,18 @@ int main(int argc, char **argv) {
     input_init();
     savestate_init();
 
+    bool restored = false;
+#ifdef JOURNAL_FILE
+    restored = savestate_journal_open(JOURNAL_FILE, canvas_file_generation());
+#endif
 
     // save start frame
-    savestate_save();
+    if (!restored)
+        savestate_save();
 
     e_window_main_loop(main_loop);
 
+    canvas_save_flush();
     e_gui_kill();
 
     return 0;
@@ -100,6 +109,9 @@ int main(int argc, char **argv) {
 
 
 static void main_loop(float delta_time) {
+    // sheets required in the last frame may be evicted from now on
+    tiles_update();
+
     // e updates
     e_input_update();
 
@@ -20,7 +20,7 @@
 
 static struct {
     uColor_s palette[PALETTE_SIZE];
-    RoBatch palette_ro;
+    RoBatch2d palette_ro;
     RoSingle palette_clear_ro;
     RoSingle select_ro;
     RoSingle background_ro;
@@ -52,6 +52,22 @@ static mat4 setup_palette_color_pose(int r, int c) {
     return pose;
 }
 
+static mat4 palette_color_pose(int i) {
+    return setup_palette_color_pose(i / TILES_COLS, i % TILES_COLS);
+}
+
+// sheet as texture layer, tile as uv in that sheet
+// required each update, so the sheet stays loaded (and its slot up to date)
+static void setup_palette_sheet() {
+    tiles_require_id(L.tile_id);
+    int slot = tiles_slot(L.tile_id);
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        L.palette_ro.rects[i].sprite.x = 0;
+        L.palette_ro.rects[i].sprite.y = slot >= 0 ? slot : 0;
+        L.palette_ro.rects[i].color.a = slot >= 0 ? 255 : 0;
+    }
+}
+
 
 //
 // public
@@ -59,8 +75,9 @@ static mat4 setup_palette_color_pose(int r, int c) {
 
 void palette_init() {
     L.tile_id = 1;
-    L.palette_ro = ro_batch_new(PALETTE_SIZE, camera.gl, tiles.textures[L.tile_id - 1]);
+    L.palette_ro = ro_batch2d_new(PALETTE_SIZE, camera.gl, tiles.sheets);
     L.palette_ro.owns_tex = false; // tiles.h owns
+    ro_batch2d_set_streaming(&L.palette_ro, true);  // updated each frame
 
     L.palette_clear_ro = ro_single_new(camera.gl, r_texture_new_file(1, 1, "res/toolbar_color_bg.png"));
 
@@ -76,15 +93,17 @@ void palette_init() {
     }
 
 
-    // setup sprites
+    // setup uvs
     int i = 0;
     for (int r = 0; r < TILES_ROWS; r++) {
         for (int c = 0; c < TILES_COLS; c++) {
-            L.palette_ro.rects[i].sprite = (vec2) {{c, r}};
+            L.palette_ro.rects[i].uv_xy = (vec2) {{(float) c / TILES_COLS, (float) r / TILES_ROWS}};
+            L.palette_ro.rects[i].uv_size = (vec2) {{1.0f / TILES_COLS, 1.0f / TILES_ROWS}};
             i++;
         }
     }
-    ro_batch_update(&L.palette_ro);
+    setup_palette_sheet();
+    ro_batch2d_update(&L.palette_ro);
 
     palette_set_color(-1);
     brush.secondary_color = brush.current_color;
@@ -92,11 +111,11 @@ void palette_init() {
 
 
 void palette_update(float dtime) {
+    setup_palette_sheet();
     for (int i = 0; i < PALETTE_SIZE; i++) {
-        int r = i / TILES_COLS;
-        int c = i % TILES_COLS;
-
-        L.palette_ro.rects[i].pose = setup_palette_color_pose(r, c);;
+        mat4 pose = palette_color_pose(i);
+        L.palette_ro.rects[i].xy = u_pose_get_xy(pose);
+        L.palette_ro.rects[i].size = (vec2) {{TILES_SIZE, TILES_SIZE}};
     }
 
     if (camera_is_portrait_mode())
@@ -123,14 +142,14 @@ void palette_update(float dtime) {
     if (L.last_selected == -1)
         L.select_ro.rect.pose = L.palette_clear_ro.rect.pose;
     else
-        L.select_ro.rect.pose = L.palette_ro.rects[L.last_selected].pose;
+        L.select_ro.rect.pose = palette_color_pose(L.last_selected);
 
-    ro_batch_update(&L.palette_ro);
+    ro_batch2d_update(&L.palette_ro);
 }
 
 void palette_render() {
     ro_single_render(&L.background_ro);
-    ro_batch_render(&L.palette_ro);
+    ro_batch2d_render(&L.palette_ro);
     ro_single_render(&L.palette_clear_ro);
     ro_single_render(&L.select_ro);
 }
@@ -144,7 +163,7 @@ bool palette_pointer_event(ePointer_s pointer) {
         return true;
 
     for (int i = 0; i < PALETTE_SIZE; i++) {
-        if (u_pose_contains(L.palette_ro.rects[i].pose, pointer.pos)) {
+        if (u_pose_contains(palette_color_pose(i), pointer.pos)) {
             palette_set_color(i);
             return true;
         }
@@ -185,7 +204,7 @@ void palette_change_tiles(bool next) {
     if (L.tile_id > tiles.size)
         L.tile_id = 1;
 
-    ro_batch_set_texture(&L.palette_ro, tiles.textures[L.tile_id - 1]);
+    setup_palette_sheet();
 
     for (int i = 0; i < PALETTE_SIZE; i++) {
         L.palette[i] = (uColor_s) {0, 0, L.tile_id, i};
@@ -0,0 +1,75 @@
+#include "rhc/error.h"
+#include "rhc/log.h"
+#include "r/render.h"
+#include "r/framebuffer.h"
+
+
+//
+// private
+//
+
+static struct {
+    GLint prev_fbo;
+    GLint prev_viewport[4];
+} L;
+
+
+//
+// public
+//
+
+rFramebuffer r_framebuffer_new(int cols, int rows) {
+    r_render_error_check("r_framebuffer_newBEGIN");
+    rFramebuffer self;
+    self.tex = r_texture_new_empty(cols, rows, 1, 1);
+
+    GLint prev_fbo;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev_fbo);
+    glGenFramebuffers(1, &self.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, self.fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, self.tex.tex, 0, 0);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        rhc_error = "framebuffer new failed";
+        log_error("r_framebuffer_new failed: incomplete: 0x%04x", status);
+        r_framebuffer_kill(&self);
+        return self;
+    }
+
+    r_render_error_check("r_framebuffer_new");
+    return self;
+}
+
+void r_framebuffer_kill(rFramebuffer *self) {
+    // invalid safe
+    glDeleteFramebuffers(1, &self->fbo);
+    r_texture_kill(&self->tex);
+    *self = r_framebuffer_new_invalid();
+}
+
+void r_framebuffer_begin(rFramebuffer self) {
+    r_render_error_check("r_framebuffer_beginBEGIN");
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &L.prev_fbo);
+    glGetIntegerv(GL_VIEWPORT, L.prev_viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, self.fbo);
+    glViewport(0, 0, self.tex.sprite_size.x, self.tex.sprite_size.y);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // color = src*a + dst*(1-a) is premultiplied for an empty dst, alpha must accumulate
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    r_render_error_check("r_framebuffer_begin");
+}
+
+void r_framebuffer_end() {
+    r_render_error_check("r_framebuffer_endBEGIN");
+    glBindFramebuffer(GL_FRAMEBUFFER, L.prev_fbo);
+    glViewport(L.prev_viewport[0], L.prev_viewport[1], L.prev_viewport[2], L.prev_viewport[3]);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glClearColor(r_render.clear_color.r, r_render.clear_color.g, r_render.clear_color.b, r_render.clear_color.a);
+    r_render_error_check("r_framebuffer_end");
+}
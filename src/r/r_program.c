@@ -1,8 +1,192 @@
+#include <inttypes.h>
 #include "rhc/error.h"
 #include "rhc/file.h"
+#include "rhc/allocator.h"
+#include "rhc/time.h"
 #include "r/render.h"
 #include "r/program.h"
 
+// linked programs are cached as binaries in the files: <pref path of org/app><key>.bin
+#ifndef R_PROGRAM_CACHE_ORG
+#define R_PROGRAM_CACHE_ORG "tilec"
+#endif
+#ifndef R_PROGRAM_CACHE_APP
+#define R_PROGRAM_CACHE_APP "program_cache"
+#endif
+#define BINARY_MAGIC 0x42504c54      // "TLPB"
+
+
+//
+// private
+//
+
+#ifdef OPTION_GLES
+static const char *program_defines = "#version 300 es\n#define OPTION_GLES\n";
+#else
+static const char *program_defines = "#version 330 core\n";
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+    uint64_t size;
+} BinaryHeader;
+
+// programs of r_program_new_file_shared
+typedef struct {
+    char file[128];
+    GLuint program;
+    int references;
+} Shared;
+
+static struct {
+    Shared *shared;
+    int shared_size;
+
+    bool binary_checked, binary_supported;
+    char *cache_dir;    // of SDL_GetPrefPath, ends with a separator
+} L;
+
+static uint64_t hash_str(uint64_t hash, const char *data, size_t size) {
+    // fnv-1a
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t) data[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+static uint64_t hash_cstr(uint64_t hash, const char *str) {
+    // with terminator, so "ab" + "c" != "a" + "bc"
+    return hash_str(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+// driver and source dependent, a driver update invalidates the binaries
+static uint64_t binary_key(Str_s source) {
+    uint64_t hash = 0xcbf29ce484222325;
+    hash = hash_cstr(hash, (const char *) glGetString(GL_VENDOR));
+    hash = hash_cstr(hash, (const char *) glGetString(GL_RENDERER));
+    hash = hash_cstr(hash, (const char *) glGetString(GL_VERSION));
+    hash = hash_cstr(hash, program_defines);
+    return hash_str(hash, source.data, source.size);
+}
+
+// program binaries are core in GL 4.1 and GLES 3.0, else ARB_get_program_binary
+static bool binary_api_available() {
+#ifdef OPTION_GLEW
+    if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri)
+        return false;
+#endif
+#ifdef OPTION_GLES
+    return true;
+#else
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 1))
+        return true;
+    GLint extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+    for (int i = 0; i < extensions; i++) {
+        const char *name = (const char *) glGetStringi(GL_EXTENSIONS, i);
+        if (name && strcmp(name, "GL_ARB_get_program_binary") == 0)
+            return true;
+    }
+    return false;
+#endif
+}
+
+// checked once, also needs a writable cache directory
+static bool binary_supported() {
+    if (L.binary_checked)
+        return L.binary_supported;
+    L.binary_checked = true;
+
+    if (!binary_api_available()) {
+        log_info("r_program: program binaries not available");
+        return false;
+    }
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0)
+        return false;
+
+    L.cache_dir = SDL_GetPrefPath(R_PROGRAM_CACHE_ORG, R_PROGRAM_CACHE_APP);
+    if (!L.cache_dir) {
+        log_warn("r_program: no cache directory: %s", SDL_GetError());
+        return false;
+    }
+    L.binary_supported = true;
+    return true;
+}
+
+// returns 0 if not cached, or rejected by the driver
+static GLuint binary_load(const char *cache_file, uint64_t key) {
+    SDL_RWops *f = SDL_RWFromFile(cache_file, "rb");
+    if (!f)
+        return 0;
+
+    BinaryHeader header;
+    void *data = NULL;
+    bool ok = SDL_RWread(f, &header, sizeof header, 1) == 1
+              && header.magic == BINARY_MAGIC
+              && header.key == key
+              && header.size > 0
+              && (Sint64) (sizeof header + header.size) == SDL_RWsize(f);
+    if (ok) {
+        data = rhc_malloc_raising(header.size);
+        ok = SDL_RWread(f, data, header.size, 1) == 1;
+    }
+    SDL_RWclose(f);
+    if (!ok) {
+        log_warn("r_program: invalid cached binary removed: %s", cache_file);
+        remove(cache_file);
+    }
+
+    GLuint program = 0;
+    if (ok) {
+        program = glCreateProgram();
+        glProgramBinary(program, header.format, data, (GLsizei) header.size);
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status == GL_FALSE) {
+            log_warn("r_program: cached binary rejected and removed: %s", cache_file);
+            remove(cache_file);
+            glDeleteProgram(program);
+            program = 0;
+            // an unknown format raises an error
+            while (glGetError() != GL_NO_ERROR);
+        }
+    }
+    rhc_free(data);
+    return program;
+}
+
+static void binary_save(GLuint program, const char *cache_file, uint64_t key) {
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0)
+        return;
+
+    char *buffer = rhc_malloc_raising(sizeof(BinaryHeader) + size);
+    BinaryHeader header = {BINARY_MAGIC, 0, key, 0};
+    GLenum format;
+    GLsizei length = 0;
+    glGetProgramBinary(program, size, &length, &format, buffer + sizeof header);
+    header.format = format;
+    header.size = length;
+    memcpy(buffer, &header, sizeof header);
+
+    if (length > 0)
+        file_write(cache_file, (Str_s) {buffer, sizeof header + length}, false);
+    rhc_free(buffer);
+}
+
+
+//
+// public
+//
 
 GLuint r_programshader_new(Str_s source, GLint shader_type) {
     r_render_error_check("r_programshader_new");
@@ -76,6 +260,8 @@ GLuint r_program_new(const GLuint *shaders, int n, bool delete_shaders) {
     GLuint program = glCreateProgram();
     for (int i = 0; i < n; i++)
         glAttachShader(program, shaders[i]);
+    if (binary_supported())
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(program);
 
     int status;
@@ -104,7 +290,25 @@ GLuint r_program_new(const GLuint *shaders, int n, bool delete_shaders) {
 
 GLuint r_program_new_file(const char *file) {
     r_render_error_check("r_program_new_fileBEGIN");
+    double time = time_monotonic();
     String source = file_read(file, true);
+
+    bool use_binary = string_valid(source) && binary_supported();
+    uint64_t key = 0;
+    char cache_file[1024];
+    if (use_binary) {
+        key = binary_key(source.str);
+        snprintf(cache_file, sizeof cache_file, "%s%016" PRIx64 ".bin", L.cache_dir, key);
+        GLuint program = binary_load(cache_file, key);
+        if (r_program_valid(program)) {
+            string_kill(&source);
+            log_info("r_program_new_file: %s loaded from cache in %.2f ms",
+                     file, (time_monotonic() - time) * 1000);
+            r_render_error_check("r_program_new_file");
+            return program;
+        }
+    }
+
     GLuint vertex = r_programshader_new(source.str, GL_VERTEX_SHADER);
     GLuint fragment = r_programshader_new(source.str, GL_FRAGMENT_SHADER);
 
@@ -115,10 +319,52 @@ GLuint r_program_new_file(const char *file) {
     glDeleteShader(fragment);
     string_kill(&source);
 
+    if (use_binary && r_program_valid(program))
+        binary_save(program, cache_file, key);
+    log_info("r_program_new_file: %s compiled in %.2f ms", file, (time_monotonic() - time) * 1000);
+
     r_render_error_check("r_program_new_file");
     return program;
 }
 
+GLuint r_program_new_file_shared(const char *file) {
+    for (int i = 0; i < L.shared_size; i++) {
+        if (strcmp(L.shared[i].file, file) == 0) {
+            L.shared[i].references++;
+            return L.shared[i].program;
+        }
+    }
+
+    GLuint program = r_program_new_file(file);
+    if (!r_program_valid(program) || strlen(file) >= sizeof L.shared->file)
+        return program;
+
+    L.shared = rhc_realloc_raising(L.shared, (L.shared_size + 1) * sizeof *L.shared);
+    Shared *s = &L.shared[L.shared_size++];
+    strcpy(s->file, file);
+    s->program = program;
+    s->references = 1;
+    log_info("r_program_new_file_shared: %s", file);
+    return program;
+}
+
+void r_program_kill_shared(GLuint program) {
+    if (!r_program_valid(program))
+        return;
+    for (int i = 0; i < L.shared_size; i++) {
+        if (L.shared[i].program != program)
+            continue;
+        if (--L.shared[i].references > 0)
+            return;
+        // move to close hole
+        L.shared[i] = L.shared[--L.shared_size];
+        break;
+    }
+    // the last reference, or not shared
+    glDeleteProgram(program);
+    r_render_invalidate_state();
+}
+
 void r_program_validate(GLuint program) {
     r_render_error_check("r_program_validateBEGIN");
     if(!r_program_valid(program))
@@ -1,5 +1,6 @@
 #include <float.h>  // FLT_MAX
 #include "mathc/float.h"
+#include "mathc/uchar.h"
 #include "r/rect.h"
 
 rRect_s r_rect_new() {
@@ -19,6 +20,25 @@ rRect_s r_rect_new_hidden() {
     return self;
 }
 
+rRect2d_s r_rect2d_new() {
+    rRect2d_s self;
+    self.xy = vec2_set(0);
+    self.size = vec2_set(1);
+    self.uv_xy = vec2_set(0);
+    self.uv_size = vec2_set(1);
+    self.angle = 0;
+    self.color = ucvec4_set(255);
+    self.sprite.x = self.sprite.y = 0;
+    return self;
+}
+
+rRect2d_s r_rect2d_new_hidden() {
+    rRect2d_s self = r_rect2d_new();
+    self.xy = vec2_set(FLT_MAX);
+    self.color.a = 0;
+    return self;
+}
+
 rParticleRect_s r_particlerect_new() {
     rParticleRect_s self;
     self.rect = r_rect_new();
@@ -9,8 +9,21 @@ struct rRenderGolabals_s r_render;
 // private
 //
 
+#define TEXTURE_UNITS 4
+#define UNKNOWN ((GLuint) -1)
+
 static struct {
    GLuint framebuffer_tex_fbo;
+
+   // current gl bindings, or UNKNOWN
+   struct {
+       GLuint program;
+       GLuint vao;
+       GLuint active_unit;
+       GLuint tex_2d[TEXTURE_UNITS];
+       GLuint tex_2d_array[TEXTURE_UNITS];
+       int avoided;
+   } state;
 } L;
 
 
@@ -40,6 +53,11 @@ void r_render_init(SDL_Window *window) {
         //exit(EXIT_FAILURE);
     }
     
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &r_render.max_texture_size);
+    log_info("r_render_init: max texture size: %d", r_render.max_texture_size);
+
+    r_render_invalidate_state();
+
     // startup "empty" texture
     r_render.framebuffer_tex = r_texture2d_new_white_pixel();
     glGenFramebuffers(1, &L.framebuffer_tex_fbo);
@@ -66,9 +84,74 @@ void r_render_end_frame() {
     
     SDL_GL_SwapWindow(r_render.window);
 
+    // others (like the gui) may have changed the bindings
+    r_render.avoided_gl_calls = L.state.avoided;
+    L.state.avoided = 0;
+    r_render_invalidate_state();
+
     r_render_error_check("r_render_end_frame");
 }
 
+void r_render_blend_premultiplied(bool premultiplied) {
+    if (premultiplied)
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    else
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void r_render_use_program(GLuint program) {
+    if (L.state.program == program) {
+        L.state.avoided++;
+        return;
+    }
+    glUseProgram(program);
+    L.state.program = program;
+}
+
+void r_render_bind_vertex_array(GLuint vao) {
+    if (L.state.vao == vao) {
+        L.state.avoided++;
+        return;
+    }
+    glBindVertexArray(vao);
+    L.state.vao = vao;
+}
+
+void r_render_bind_texture(int unit, GLenum target, GLuint tex) {
+    // also activates the unit, texture uploads need it
+    if (L.state.active_unit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        L.state.active_unit = unit;
+    } else {
+        L.state.avoided++;
+    }
+
+    GLuint *bound = NULL;
+    if (unit >= 0 && unit < TEXTURE_UNITS) {
+        if (target == GL_TEXTURE_2D)
+            bound = &L.state.tex_2d[unit];
+        else if (target == GL_TEXTURE_2D_ARRAY)
+            bound = &L.state.tex_2d_array[unit];
+    }
+    if (bound && *bound == tex) {
+        L.state.avoided++;
+        return;
+    }
+    glBindTexture(target, tex);
+    if (bound)
+        *bound = tex;
+}
+
+void r_render_invalidate_state() {
+    L.state.program = UNKNOWN;
+    L.state.vao = UNKNOWN;
+    L.state.active_unit = UNKNOWN;
+    for (int i = 0; i < TEXTURE_UNITS; i++) {
+        L.state.tex_2d[i] = UNKNOWN;
+        L.state.tex_2d_array[i] = UNKNOWN;
+    }
+}
+
 void r_render_blit_framebuffer(int cols, int rows) {
     r_render_error_check("r_render_blit_framebufferBEGIN");
 
@@ -0,0 +1,132 @@
+#include <string.h>
+#include "rhc/error.h"
+#include "rhc/log.h"
+#include "r/render.h"
+#include "r/stream.h"
+
+
+//
+// private
+//
+
+static void clear_fence(rStream *self, int i) {
+    if (self->fence[i])
+        glDeleteSync(self->fence[i]);
+    self->fence[i] = NULL;
+}
+
+static void mark_dirty(rStream *self, int i, int begin, int end) {
+    if (begin < self->dirty_begin[i])
+        self->dirty_begin[i] = begin;
+    if (end > self->dirty_end[i])
+        self->dirty_end[i] = end;
+}
+
+// not fenced or already passed by the gpu
+static bool buffer_free(rStream *self, int i) {
+    if (!self->fence[i])
+        return true;
+    GLenum res = glClientWaitSync(self->fence[i], 0, 0);
+    if (res == GL_ALREADY_SIGNALED || res == GL_CONDITION_SATISFIED) {
+        clear_fence(self, i);
+        return true;
+    }
+    return false;
+}
+
+
+//
+// public
+//
+
+rStream r_stream_new(int size) {
+    r_render_error_check("r_stream_newBEGIN");
+    assume(size > 0, "stream needs a size");
+    rStream self = {0};
+    self.size = size;
+    // not written yet
+    for (int i = 0; i < R_STREAM_RING; i++) {
+        self.dirty_begin[i] = 0;
+        self.dirty_end[i] = size;
+    }
+    glGenVertexArrays(R_STREAM_RING, self.vao);
+    glGenBuffers(R_STREAM_RING, self.vbo);
+    for (int i = 0; i < R_STREAM_RING; i++) {
+        glBindBuffer(GL_ARRAY_BUFFER, self.vbo[i]);
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    r_render_error_check("r_stream_new");
+    return self;
+}
+
+void r_stream_kill(rStream *self) {
+    for (int i = 0; i < R_STREAM_RING; i++)
+        clear_fence(self, i);
+    glDeleteVertexArrays(R_STREAM_RING, self->vao);
+    r_render_invalidate_state();
+    glDeleteBuffers(R_STREAM_RING, self->vbo);
+    *self = (rStream) {0};
+}
+
+void r_stream_upload(rStream *self, const void *data) {
+    r_stream_upload_sub(self, data, 0, self->size);
+}
+
+void r_stream_upload_sub(rStream *self, const void *data, int offset, int size) {
+    r_render_error_check("r_stream_upload_subBEGIN");
+    if (offset < 0)
+        offset = 0;
+    if (size > self->size - offset)
+        size = self->size - offset;
+    for (int i = 0; i < R_STREAM_RING; i++)
+        mark_dirty(self, i, offset, offset + size);
+
+    int next = (self->current + 1) % R_STREAM_RING;
+    int begin = self->dirty_begin[next];
+    int end = self->dirty_end[next];
+    self->current = next;
+    if (begin >= end)
+        return;
+    self->dirty_begin[next] = self->size;
+    self->dirty_end[next] = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->vbo[next]);
+
+    void *dst = NULL;
+    if (buffer_free(self, next)) {
+        // the rest of the buffer is still valid, so only the range is invalidated
+        GLbitfield invalidate = begin == 0 && end == self->size ?
+                                GL_MAP_INVALIDATE_BUFFER_BIT : GL_MAP_INVALIDATE_RANGE_BIT;
+        dst = glMapBufferRange(GL_ARRAY_BUFFER, begin, end - begin,
+                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | invalidate);
+    } else {
+        self->orphaned++;
+        clear_fence(self, next);
+    }
+
+    if (dst) {
+        memcpy(dst, (const char *) data + begin, end - begin);
+        self->uploaded += end - begin;
+        if (!glUnmapBuffer(GL_ARRAY_BUFFER)) {
+            // storage got corrupted (display mode change, ...)
+            log_warn("r_stream_upload: unmap failed, reuploading");
+            glBufferData(GL_ARRAY_BUFFER, self->size, data, GL_STREAM_DRAW);
+            self->uploaded += self->size;
+        }
+    } else {
+        // orphan, the new storage needs all of the data
+        glBufferData(GL_ARRAY_BUFFER, self->size, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, self->size, data);
+        self->uploaded += self->size;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    r_render_error_check("r_stream_upload_sub");
+}
+
+void r_stream_fence(rStream *self) {
+    // a later draw of the same buffer replaces the fence
+    clear_fence(self, self->current);
+    self->fence[self->current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -14,22 +14,39 @@ _Static_assert(sizeof(ucvec4) == 4, "wtf");
 // private
 //
 
-// grid to vertical
-static void reorder(ucvec4 *dst, const ucvec4 *src, ivec2 sprite_size, ivec2 sprites) {
-   
-    for(int sr=0; sr<sprites.y; sr++) {
-        for(int sc=0; sc<sprites.x; sc++) {
-            for(int r=0; r<sprite_size.y; r++) {
-                int src_row = sr*sprite_size.y + r;
-                int src_col = sc*sprite_size.x;
-                int src_idx = src_row * sprite_size.x * sprites.x + src_col;
-                int dst_row = sr*sprite_size.y*sprites.x + sc*sprite_size.y + r;
-                int dst_idx = dst_row * sprite_size.x;
-            
-                memcpy(&dst[dst_idx], &src[src_idx], sprite_size.x * sizeof(ucvec4));
-            }
-        }
-    }   
+// uploads the layers [begin, end) straight from the sprite grid buffer
+// the unpack state picks each sprite out of the grid, so no reorder copy is needed
+static void upload_grid(rTexture self, int begin, int end, const void *buffer) {
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self.tex);
+
+    if (self.sprites.x == 1) {
+        // a single column is already vertical
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0,
+                0, 0, begin,
+                self.sprite_size.x,
+                self.sprite_size.y,
+                end - begin,
+                GL_RGBA, GL_UNSIGNED_BYTE,
+                (const ucvec4 *) buffer + begin * self.sprite_size.x * self.sprite_size.y);
+        return;
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, self.sprite_size.x * self.sprites.x);
+    for (int layer = begin; layer < end; layer++) {
+        int sc = layer % self.sprites.x;
+        int sr = layer / self.sprites.x;
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, sc * self.sprite_size.x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, sr * self.sprite_size.y);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0,
+                0, 0, layer,
+                self.sprite_size.x,
+                self.sprite_size.y,
+                1,
+                GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 }
 
 
@@ -57,23 +74,17 @@ rTexture r_texture_new(int image_cols, int image_rows, int sprites_cols, int spr
         {{sprites_cols, sprites_rows}}
     };
     
-    // reorder vertical
-    void *tmp_buffer = NULL;
-    if(opt_buffer && self.sprites.x > 1) {
-        tmp_buffer = rhc_malloc_raising(4 * image_cols * image_rows);
-        
-        reorder(tmp_buffer, opt_buffer, self.sprite_size, self.sprites);
-        opt_buffer = tmp_buffer;
-    }
-    
     glGenTextures(1, &self.tex);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self.tex);
 
     glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA,
              self.sprite_size.x, 
              self.sprite_size.y, 
              self.sprites.x * self.sprites.y,
-             0, GL_RGBA, GL_UNSIGNED_BYTE, opt_buffer);
+             0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    if(opt_buffer)
+        upload_grid(self, 0, self.sprites.x * self.sprites.y, opt_buffer);
 
     // GL_REPEAT is already default...
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -81,8 +92,6 @@ rTexture r_texture_new(int image_cols, int image_rows, int sprites_cols, int spr
 
     r_texture_filter_nearest(self);
     
-    // NULL safe free
-    rhc_free(tmp_buffer);
     r_render_error_check("r_texture_new");
     return self;
 }
@@ -123,6 +132,8 @@ rTexture r_texture_new_white_pixel() {
 void r_texture_kill(rTexture *self) {
     // invalid safe
     glDeleteTextures(1, &self->tex);
+    // the name may be reused, while still in the cached state
+    r_render_invalidate_state();
     *self = r_texture_new_invalid();
 }
 
@@ -131,28 +142,80 @@ void r_texture_set(rTexture self, const void *buffer) {
     if(!r_texture_valid(self) || !buffer)
         return;
 
-    // reorder vertical
-    void *tmp_buffer = NULL;
-    if(self.sprites.x > 1) {
-        int image_cols = self.sprite_size.x * self.sprites.x;
-        int image_rows = self.sprite_size.y * self.sprites.y;
-        tmp_buffer = rhc_malloc_raising(4 * image_cols * image_rows);
+    upload_grid(self, 0, self.sprites.x * self.sprites.y, buffer);
+    r_render_error_check("r_texture_set");
+}
+
+void r_texture_set_sprites(rTexture self, int sprite_begin, int sprite_end, const void *buffer) {
+    r_render_error_check("r_texture_set_spritesBEGIN");
+    int size = self.sprites.x * self.sprites.y;
+    if(!r_texture_valid(self) || !buffer)
+        return;
+    sprite_begin = sprite_begin < 0 ? 0 : sprite_begin;
+    sprite_end = sprite_end > size ? size : sprite_end;
+    if(sprite_begin >= sprite_end)
+        return;
 
-        reorder(tmp_buffer, buffer, self.sprite_size, self.sprites);
-        buffer = tmp_buffer;
+    upload_grid(self, sprite_begin, sprite_end, buffer);
+    r_render_error_check("r_texture_set_sprites");
+}
+
+void r_texture_set_sub(rTexture self, int left, int top, int cols, int rows, const void *buffer) {
+    r_render_error_check("r_texture_set_subBEGIN");
+    if(!r_texture_valid(self) || !buffer)
+        return;
+    int image_cols = self.sprite_size.x * self.sprites.x;
+    int image_rows = self.sprite_size.y * self.sprites.y;
+    int right = left + cols > image_cols ? image_cols : left + cols;
+    int bottom = top + rows > image_rows ? image_rows : top + rows;
+    left = left < 0 ? 0 : left;
+    top = top < 0 ? 0 : top;
+    if(left >= right || top >= bottom)
+        return;
+
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self.tex);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image_cols);
+
+    // each sprite, that intersects the rect, gets its part of the rect
+    for(int sr = top / self.sprite_size.y; sr * self.sprite_size.y < bottom; sr++) {
+        for(int sc = left / self.sprite_size.x; sc * self.sprite_size.x < right; sc++) {
+            int x = sc * self.sprite_size.x;
+            int y = sr * self.sprite_size.y;
+            int l = left > x ? left : x;
+            int t = top > y ? top : y;
+            int r = right < x + self.sprite_size.x ? right : x + self.sprite_size.x;
+            int b = bottom < y + self.sprite_size.y ? bottom : y + self.sprite_size.y;
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, l);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, t);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0,
+                    l - x, t - y, sr * self.sprites.x + sc,
+                    r - l, b - t, 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+        }
     }
 
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self.tex);
-    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 
-            0, 0, 0, 
-            self.sprite_size.x, 
-            self.sprite_size.y, 
-            self.sprites.x * self.sprites.y,
-            GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    r_render_error_check("r_texture_set_sub");
+}
 
-    // NULL safe free
-    rhc_free(tmp_buffer);
-    r_render_error_check("r_texture_set");
+void r_texture_set_sprite(rTexture self, int sprite_col, int sprite_row, const void *buffer) {
+    r_render_error_check("r_texture_set_spriteBEGIN");
+    if(!r_texture_valid(self) || !buffer
+            || sprite_col < 0 || sprite_col >= self.sprites.x
+            || sprite_row < 0 || sprite_row >= self.sprites.y)
+        return;
+
+    // a sprite is a single layer, no reorder needed
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self.tex);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0,
+            0, 0, sprite_row * self.sprites.x + sprite_col,
+            self.sprite_size.x,
+            self.sprite_size.y,
+            1,
+            GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+    r_render_error_check("r_texture_set_sprite");
 }
 
 
@@ -160,7 +223,7 @@ void r_texture_filter_linear(rTexture self) {
     r_render_error_check("r_texture_filter_linearBEGIN");
     if(!r_texture_valid(self))
         return;
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self.tex);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
@@ -171,7 +234,7 @@ void r_texture_filter_nearest(rTexture self) {
     r_render_error_check("r_texture_filter_nearestBEGIN");   
     if(!r_texture_valid(self))
         return;
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self.tex);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     r_render_error_check("r_texture_filter_nearest");
@@ -15,7 +15,7 @@ rTexture2D r_texture2d_new(int image_cols, int image_rows, const void *opt_buffe
     
     
     glGenTextures(1, &self.tex);
-    glBindTexture(GL_TEXTURE_2D, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D, self.tex);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
              self.size.x, self.size.y, 
@@ -66,6 +66,8 @@ rTexture2D r_texture2d_new_white_pixel() {
 void r_texture2d_kill(rTexture2D *self) {
     // invalid safe
     glDeleteTextures(1, &self->tex);
+    // the name may be reused, while still in the cached state
+    r_render_invalidate_state();
     *self = r_texture2d_new_invalid();
 }
 
@@ -73,7 +75,7 @@ void r_texture2d_set(rTexture2D self, const void *buffer) {
     r_render_error_check("r_texture2d_setBEGIN");
     if(!r_texture2d_valid(self))
         return;
-    glBindTexture(GL_TEXTURE_2D, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D, self.tex);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 
             0, 0, self.size.x, self.size.y, 
             GL_RGBA, GL_UNSIGNED_BYTE, buffer);
@@ -84,7 +86,7 @@ void r_texture2d_get(rTexture2D self, void *buffer) {
     r_render_error_check("r_texture2d_getBEGIN");
     if(!r_texture2d_valid(self) || !buffer)
         return;
-    glBindTexture(GL_TEXTURE_2D, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D, self.tex);
     GLuint fbo; 
     glGenFramebuffers(1, &fbo); 
     glBindFramebuffer(GL_FRAMEBUFFER, fbo); 
@@ -100,7 +102,7 @@ void r_texture2d_filter_linear(rTexture2D self) {
     r_render_error_check("r_texture2d_filter_linearBEGIN");
     if(!r_texture2d_valid(self))
         return;
-    glBindTexture(GL_TEXTURE_2D, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D, self.tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glGenerateMipmap(GL_TEXTURE_2D);
@@ -111,7 +113,7 @@ void r_texture2d_filter_nearest(rTexture2D self) {
     r_render_error_check("r_texture2d_filter_nearestBEGIN");   
     if(!r_texture2d_valid(self))
         return;
-    glBindTexture(GL_TEXTURE_2D, self.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D, self.tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     r_render_error_check("r_texture2d_filter_nearest");
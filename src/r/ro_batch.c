@@ -5,6 +5,58 @@
 #include "r/ro_batch.h"
 
 
+//
+// private
+//
+
+// sets up the attributes of the bound vao
+static void setup_attributes(GLuint vbo) {
+    const int loc_pose = 0;
+    const int loc_uv = 4;
+    const int loc_color = 8;
+    const int loc_sprite = 9;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // pose
+    for (int c = 0; c < 4; c++) {
+        int loc = loc_pose + c;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
+                              sizeof(rRect_s), (void *) (c * sizeof(vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    // uv
+    for (int c = 0; c < 4; c++) {
+        int loc = loc_uv + c;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
+                              sizeof(rRect_s), (void *) (offsetof(rRect_s, uv) + c * sizeof(vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    // color
+    glEnableVertexAttribArray(loc_color);
+    glVertexAttribPointer(loc_color, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rRect_s),
+                          (void *) offsetof(rRect_s, color));
+    glVertexAttribDivisor(loc_color, 1);
+
+    // sprite
+    glEnableVertexAttribArray(loc_sprite);
+    glVertexAttribPointer(loc_sprite, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(rRect_s),
+                          (void *) offsetof(rRect_s, sprite));
+    glVertexAttribDivisor(loc_sprite, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+//
+// public
+//
 
 RoBatch ro_batch_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s alloc) {
     r_render_error_check("ro_batch_newBEGIN");
@@ -21,11 +73,13 @@ RoBatch ro_batch_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s
     self.num = num;
     self.vp = vp;
 
-    self.L.program = r_program_new_file("res/r/batch.glsl");
-    const int loc_pose = 0;
-    const int loc_uv = 4;
-    const int loc_color = 8;
-    const int loc_sprite = 9;
+    self.L.program = r_program_new_file_shared("res/r/batch.glsl");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_sprites = glGetUniformLocation(self.L.program, "sprites");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex"), 0);
 
     self.L.tex = tex_sink;
     self.owns_tex = true;
@@ -33,7 +87,7 @@ RoBatch ro_batch_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s
     // L.vao scope
     {
         glGenVertexArrays(1, &self.L.vao);
-        glBindVertexArray(self.L.vao);
+        r_render_bind_vertex_array(self.L.vao);
 
         // L.vbo
         {
@@ -43,47 +97,15 @@ RoBatch ro_batch_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s
                          num * sizeof(rRect_s),
                          self.rects,
                          GL_STREAM_DRAW);
-
-            glBindVertexArray(self.L.vao);
-
-            // pose
-            for (int c = 0; c < 4; c++) {
-                int loc = loc_pose + c;
-                glEnableVertexAttribArray(loc);
-                glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
-                                      sizeof(rRect_s), (void *) (c * sizeof(vec4)));
-                glVertexAttribDivisor(loc, 1);
-            }
-
-            // uv
-            for (int c = 0; c < 4; c++) {
-                int loc = loc_uv + c;
-                glEnableVertexAttribArray(loc);
-                glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
-                                      sizeof(rRect_s), (void *) (offsetof(rRect_s, uv) + c * sizeof(vec4)));
-                glVertexAttribDivisor(loc, 1);
-            }
-
-            // color
-            glEnableVertexAttribArray(loc_color);
-            glVertexAttribPointer(loc_color, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rRect_s),
-                                  (void *) offsetof(rRect_s, color));
-            glVertexAttribDivisor(loc_color, 1);
-            
-            // sprite
-            glEnableVertexAttribArray(loc_sprite);
-            glVertexAttribPointer(loc_sprite, 2, GL_FLOAT, GL_FALSE,
-                                  sizeof(rRect_s),
-                                  (void *) offsetof(rRect_s, sprite));
-            glVertexAttribDivisor(loc_sprite, 1);
-
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
+        setup_attributes(self.L.vbo);
 
-        glBindVertexArray(0);
+        r_render_bind_vertex_array(0);
     }
     
+    self.L.streaming = false;
+    self.L.stream = (rStream) {0};
+
     r_render_error_check("ro_batch_new");
     return self;
 }
@@ -92,9 +114,12 @@ RoBatch ro_batch_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s
 
 void ro_batch_kill(RoBatch *self) {
     self->L.allocator.free(self->L.allocator, self->rects);
-    glDeleteProgram(self->L.program);
+    r_program_kill_shared(self->L.program);
     glDeleteVertexArrays(1, &self->L.vao);
+    r_render_invalidate_state();
     glDeleteBuffers(1, &self->L.vbo);
+    if (self->L.streaming)
+        r_stream_kill(&self->L.stream);
     if (self->owns_tex)
         r_texture_kill(&self->L.tex);
     *self = (RoBatch) {0};
@@ -102,11 +127,23 @@ void ro_batch_kill(RoBatch *self) {
 
 void ro_batch_update_sub(RoBatch *self, int offset, int size) {
     r_render_error_check("ro_batch_updateBEGIN");
-    glBindBuffer(GL_ARRAY_BUFFER, self->L.vbo);
-
     offset = isca_clamp(offset, 0, self->num-1);
     size = isca_clamp(size, 1, self->num);
 
+    if (self->L.streaming) {
+        // a wrapped range is uploaded as a whole
+        if (offset + size > self->num) {
+            offset = 0;
+            size = self->num;
+        }
+        r_stream_upload_sub(&self->L.stream, self->rects,
+                            offset * sizeof(rRect_s), size * sizeof(rRect_s));
+        r_render_error_check("ro_batch_update");
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->L.vbo);
+
     if (offset + size > self->num) {
         int to_end = self->num - offset;
         int from_start = size - to_end;
@@ -134,27 +171,25 @@ void ro_batch_update_sub(RoBatch *self, int offset, int size) {
 
 void ro_batch_render_sub(RoBatch *self, int num) {
     r_render_error_check("ro_batch_renderBEGIN");
-    glUseProgram(self->L.program);
+    r_render_use_program(self->L.program);
 
     // base
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "vp"),
+    glUniformMatrix4fv(self->L.loc_vp,
                        1, GL_FALSE, self->vp);
                        
     vec2 sprites = vec2_cast_from_int(&self->L.tex.sprites.v0);
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprites"), 1, &sprites.v0);
+    glUniform2fv(self->L.loc_sprites, 1, &sprites.v0);
 
-    glUniform1i(glGetUniformLocation(self->L.program, "tex"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
 
     {
-        glBindVertexArray(self->L.vao);
+        r_render_bind_vertex_array(self->L.streaming ? r_stream_vao(self->L.stream) : self->L.vao);
         // r_program_validate(self->L.program); // debug test
         glDrawArraysInstanced(GL_TRIANGLES, 0, 6, num);
-        glBindVertexArray(0);
+        if (self->L.streaming)
+            r_stream_fence(&self->L.stream);
     }
 
-    glUseProgram(0);
     r_render_error_check("ro_batch_render");
 }
 
@@ -164,3 +199,21 @@ void ro_batch_set_texture(RoBatch *self, rTexture tex_sink) {
     self->L.tex = tex_sink;
 }
 
+void ro_batch_set_streaming(RoBatch *self, bool streaming) {
+    if (self->L.streaming == streaming)
+        return;
+    if (!streaming) {
+        r_stream_kill(&self->L.stream);
+        self->L.streaming = false;
+        ro_batch_update(self);
+        return;
+    }
+    self->L.stream = r_stream_new(self->num * sizeof(rRect_s));
+    for (int i = 0; i < R_STREAM_RING; i++) {
+        r_render_bind_vertex_array(self->L.stream.vao[i]);
+        setup_attributes(self->L.stream.vbo[i]);
+    }
+    r_render_bind_vertex_array(0);
+    self->L.streaming = true;
+    ro_batch_update(self);
+}
@@ -0,0 +1,222 @@
+#include "mathc/float.h"
+#include "mathc/sca/int.h"
+#include "r/render.h"
+#include "r/program.h"
+#include "r/ro_batch2d.h"
+
+
+//
+// private
+//
+
+// sets up the attributes of the bound vao
+static void setup_attributes(GLuint vbo) {
+    const int loc_pose = 0;
+    const int loc_uv = 1;
+    const int loc_angle = 2;
+    const int loc_color = 3;
+    const int loc_sprite = 4;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // pose as xy, size
+    glEnableVertexAttribArray(loc_pose);
+    glVertexAttribPointer(loc_pose, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rRect2d_s),
+                          (void *) offsetof(rRect2d_s, xy));
+    glVertexAttribDivisor(loc_pose, 1);
+
+    // uv as uv_xy, uv_size
+    glEnableVertexAttribArray(loc_uv);
+    glVertexAttribPointer(loc_uv, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rRect2d_s),
+                          (void *) offsetof(rRect2d_s, uv_xy));
+    glVertexAttribDivisor(loc_uv, 1);
+
+    // angle
+    glEnableVertexAttribArray(loc_angle);
+    glVertexAttribPointer(loc_angle, 1, GL_FLOAT, GL_FALSE,
+                          sizeof(rRect2d_s),
+                          (void *) offsetof(rRect2d_s, angle));
+    glVertexAttribDivisor(loc_angle, 1);
+
+    // color, normalized to [0:1]
+    glEnableVertexAttribArray(loc_color);
+    glVertexAttribPointer(loc_color, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(rRect2d_s),
+                          (void *) offsetof(rRect2d_s, color));
+    glVertexAttribDivisor(loc_color, 1);
+
+    // sprite
+    glEnableVertexAttribArray(loc_sprite);
+    glVertexAttribPointer(loc_sprite, 2, GL_UNSIGNED_SHORT, GL_FALSE,
+                          sizeof(rRect2d_s),
+                          (void *) offsetof(rRect2d_s, sprite));
+    glVertexAttribDivisor(loc_sprite, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+//
+// public
+//
+
+RoBatch2d ro_batch2d_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s alloc) {
+    r_render_error_check("ro_batch2d_newBEGIN");
+    RoBatch2d self;
+    self.L.allocator = alloc;
+
+    assume(num>0, "batch needs atleast 1 rect");
+    self.rects = alloc.malloc(alloc, num * sizeof(rRect2d_s));
+    assume(self.rects, "allocation failed");
+    for(int i=0; i<num; i++) {
+        self.rects[i] = r_rect2d_new();
+    }
+
+    self.num = num;
+    self.vp = vp;
+
+    self.L.program = r_program_new_file_shared("res/r/batch2d.glsl");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_sprites = glGetUniformLocation(self.L.program, "sprites");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex"), 0);
+
+    self.L.tex = tex_sink;
+    self.owns_tex = true;
+
+    // L.vao scope
+    {
+        glGenVertexArrays(1, &self.L.vao);
+        r_render_bind_vertex_array(self.L.vao);
+
+        // L.vbo
+        {
+            glGenBuffers(1, &self.L.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, self.L.vbo);
+            glBufferData(GL_ARRAY_BUFFER,
+                         num * sizeof(rRect2d_s),
+                         self.rects,
+                         GL_STREAM_DRAW);
+        }
+        setup_attributes(self.L.vbo);
+
+        r_render_bind_vertex_array(0);
+    }
+
+    self.L.streaming = false;
+    self.L.stream = (rStream) {0};
+
+    r_render_error_check("ro_batch2d_new");
+    return self;
+}
+
+
+
+void ro_batch2d_kill(RoBatch2d *self) {
+    self->L.allocator.free(self->L.allocator, self->rects);
+    r_program_kill_shared(self->L.program);
+    glDeleteVertexArrays(1, &self->L.vao);
+    r_render_invalidate_state();
+    glDeleteBuffers(1, &self->L.vbo);
+    if (self->L.streaming)
+        r_stream_kill(&self->L.stream);
+    if (self->owns_tex)
+        r_texture_kill(&self->L.tex);
+    *self = (RoBatch2d) {0};
+}
+
+void ro_batch2d_update_sub(RoBatch2d *self, int offset, int size) {
+    r_render_error_check("ro_batch2d_updateBEGIN");
+    offset = isca_clamp(offset, 0, self->num-1);
+    size = isca_clamp(size, 1, self->num);
+
+    if (self->L.streaming) {
+        // a wrapped range is uploaded as a whole
+        if (offset + size > self->num) {
+            offset = 0;
+            size = self->num;
+        }
+        r_stream_upload_sub(&self->L.stream, self->rects,
+                            offset * sizeof(rRect2d_s), size * sizeof(rRect2d_s));
+        r_render_error_check("ro_batch2d_update");
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->L.vbo);
+
+    if (offset + size > self->num) {
+        int to_end = self->num - offset;
+        int from_start = size - to_end;
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        offset * sizeof(rRect2d_s),
+                        to_end * sizeof(rRect2d_s),
+                        self->rects + offset);
+
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        0,
+                        from_start * sizeof(rRect2d_s),
+                        self->rects);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        offset * sizeof(rRect2d_s),
+                        size * sizeof(rRect2d_s),
+                        self->rects + offset);
+
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    r_render_error_check("ro_batch2d_update");
+}
+
+
+void ro_batch2d_render_sub(RoBatch2d *self, int num) {
+    r_render_error_check("ro_batch2d_renderBEGIN");
+    r_render_use_program(self->L.program);
+
+    // base
+    glUniformMatrix4fv(self->L.loc_vp,
+                       1, GL_FALSE, self->vp);
+
+    vec2 sprites = vec2_cast_from_int(&self->L.tex.sprites.v0);
+    glUniform2fv(self->L.loc_sprites, 1, &sprites.v0);
+
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
+
+    {
+        r_render_bind_vertex_array(self->L.streaming ? r_stream_vao(self->L.stream) : self->L.vao);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, num);
+        if (self->L.streaming)
+            r_stream_fence(&self->L.stream);
+    }
+
+    r_render_error_check("ro_batch2d_render");
+}
+
+void ro_batch2d_set_texture(RoBatch2d *self, rTexture tex_sink) {
+    if (self->owns_tex)
+        r_texture_kill(&self->L.tex);
+    self->L.tex = tex_sink;
+}
+
+void ro_batch2d_set_streaming(RoBatch2d *self, bool streaming) {
+    if (self->L.streaming == streaming)
+        return;
+    if (!streaming) {
+        r_stream_kill(&self->L.stream);
+        self->L.streaming = false;
+        ro_batch2d_update(self);
+        return;
+    }
+    self->L.stream = r_stream_new(self->num * sizeof(rRect2d_s));
+    for (int i = 0; i < R_STREAM_RING; i++) {
+        r_render_bind_vertex_array(self->L.stream.vao[i]);
+        setup_attributes(self->L.stream.vbo[i]);
+    }
+    r_render_bind_vertex_array(0);
+    self->L.streaming = true;
+    ro_batch2d_update(self);
+}
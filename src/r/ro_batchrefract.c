@@ -27,7 +27,19 @@ RoBatchRefract ro_batchrefract_new_a(int num,
     self.scale = scale_ptr;
     self.view_aabb = &VIEW_AABB_FULLSCREEN.v0;
 
-    self.L.program = r_program_new_file("res/r/batchrefract.glsl");
+    self.L.program = r_program_new_file_shared("res/r/batchrefract.glsl");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_sprites = glGetUniformLocation(self.L.program, "sprites");
+    self.L.loc_scale = glGetUniformLocation(self.L.program, "scale");
+    self.L.loc_view_aabb = glGetUniformLocation(self.L.program, "view_aabb");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex_main"), 0);
+
+    glUniform1i(glGetUniformLocation(self.L.program, "tex_refraction"), 1);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex_framebuffer"), 2);
+
     const int loc_pose = 0;
     const int loc_uv = 4;
     const int loc_color = 8;
@@ -44,7 +56,7 @@ RoBatchRefract ro_batchrefract_new_a(int num,
     // vao scope
     {
         glGenVertexArrays(1, &self.L.vao);
-        glBindVertexArray(self.L.vao);
+        r_render_bind_vertex_array(self.L.vao);
 
         // vbo
         {
@@ -55,7 +67,7 @@ RoBatchRefract ro_batchrefract_new_a(int num,
                          self.rects,
                          GL_STREAM_DRAW);
 
-            glBindVertexArray(self.L.vao);
+            r_render_bind_vertex_array(self.L.vao);
 
             // pose
             for (int c = 0; c < 4; c++) {
@@ -92,7 +104,7 @@ RoBatchRefract ro_batchrefract_new_a(int num,
             glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
-        glBindVertexArray(0);
+        r_render_bind_vertex_array(0);
     }
     
     r_render_error_check("ro_batchrefract_new");
@@ -102,8 +114,9 @@ RoBatchRefract ro_batchrefract_new_a(int num,
 
 void ro_batchrefract_kill(RoBatchRefract *self) {
     self->L.allocator.free(self->L.allocator, self->rects);
-    glDeleteProgram(self->L.program);
+    r_program_kill_shared(self->L.program);
     glDeleteVertexArrays(1, &self->L.vao);
+    r_render_invalidate_state();
     glDeleteBuffers(1, &self->L.vbo);
     if (self->owns_tex_main)
         r_texture_kill(&self->L.tex_main);
@@ -146,40 +159,32 @@ void ro_batchrefract_update_sub(RoBatchRefract *self, int offset, int size) {
 
 void ro_batchrefract_render_sub(RoBatchRefract *self, int num) {
     r_render_error_check("ro_batchrefract_renderBEGIN");
-    glUseProgram(self->L.program);
+    r_render_use_program(self->L.program);
 
     // base
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "vp"),
+    glUniformMatrix4fv(self->L.loc_vp,
                        1, GL_FALSE, self->vp);
                        
     vec2 sprites = vec2_cast_from_int(&self->L.tex_main.sprites.v0);
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprites"), 1, &sprites.v0);
+    glUniform2fv(self->L.loc_sprites, 1, &sprites.v0);
 
     // fragment shader
-    glUniform1f(glGetUniformLocation(self->L.program, "scale"), *self->scale);
+    glUniform1f(self->L.loc_scale, *self->scale);
     
-    glUniform4fv(glGetUniformLocation(self->L.program, "view_aabb"), 1, self->view_aabb);
+    glUniform4fv(self->L.loc_view_aabb, 1, self->view_aabb);
 
-    glUniform1i(glGetUniformLocation(self->L.program, "tex_main"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex_main.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self->L.tex_main.tex);
     
-    glUniform1i(glGetUniformLocation(self->L.program, "tex_refraction"), 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex_refraction.tex);
+    r_render_bind_texture(1, GL_TEXTURE_2D_ARRAY, self->L.tex_refraction.tex);
     
-    glUniform1i(glGetUniformLocation(self->L.program, "tex_framebuffer"), 2);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, self->tex_framebuffer_ptr->tex);
+    r_render_bind_texture(2, GL_TEXTURE_2D, self->tex_framebuffer_ptr->tex);
 
     {
-        glBindVertexArray(self->L.vao);
+        r_render_bind_vertex_array(self->L.vao);
         // r_program_validate(self->L.program); // debug test
         glDrawArraysInstanced(GL_TRIANGLES, 0, 6, num);
-        glBindVertexArray(0);
     }
 
-    glUseProgram(0);
     r_render_error_check("ro_batchrefract_render");
 }
 
@@ -7,6 +7,102 @@
 #include "r/ro_particle.h"
 
 
+//
+// private
+//
+
+// sets up the attributes of the bound vao
+static void setup_attributes(GLuint vbo) {
+    const int loc_pose = 0;
+    const int loc_uv = 4;
+    const int loc_color = 8;
+    const int loc_sprite_and_sprite_speed = 9;
+
+    const int loc_speed = 10;
+    const int loc_acc = 11;
+    const int loc_axis_angle = 12;
+    const int loc_color_speed = 13;
+
+    const int loc_start_time = 14;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // pose
+    for (int c = 0; c < 4; c++) {
+        int loc = loc_pose + c;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
+                              sizeof(rParticleRect_s), (void *) (c * sizeof(vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    // uv
+    for (int c = 0; c < 4; c++) {
+        int loc = loc_uv + c;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
+                              sizeof(rParticleRect_s),
+                              (void *) (offsetof(rParticleRect_s, uv) + c * sizeof(vec4)));
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    // color
+    glEnableVertexAttribArray(loc_color);
+    glVertexAttribPointer(loc_color, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, color));
+    glVertexAttribDivisor(loc_color, 1);
+
+    // sprite_and_sprite_speed
+    glEnableVertexAttribArray(loc_sprite_and_sprite_speed);
+    glVertexAttribPointer(loc_sprite_and_sprite_speed, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, sprite));
+    glVertexAttribDivisor(loc_sprite_and_sprite_speed, 1);
+
+    // speed
+    glEnableVertexAttribArray(loc_speed);
+    glVertexAttribPointer(loc_speed, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, speed));
+    glVertexAttribDivisor(loc_speed, 1);
+
+    // acc
+    glEnableVertexAttribArray(loc_acc);
+    glVertexAttribPointer(loc_acc, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, acc));
+    glVertexAttribDivisor(loc_acc, 1);
+
+    // axis_angle
+    glEnableVertexAttribArray(loc_axis_angle);
+    glVertexAttribPointer(loc_axis_angle, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, axis_angle));
+    glVertexAttribDivisor(loc_axis_angle, 1);
+
+    // color_speed
+    glEnableVertexAttribArray(loc_color_speed);
+    glVertexAttribPointer(loc_color_speed, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, color_speed));
+    glVertexAttribDivisor(loc_color_speed, 1);
+
+    // start_time
+    glEnableVertexAttribArray(loc_start_time);
+    glVertexAttribPointer(loc_start_time, 1, GL_FLOAT, GL_FALSE,
+                          sizeof(rParticleRect_s),
+                          (void *) offsetof(rParticleRect_s, start_time));
+    glVertexAttribDivisor(loc_start_time, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+//
+// public
+//
+
 RoParticle ro_particle_new_a(int num, const float *vp, rTexture tex_sink, Allocator_s alloc) {
     r_render_error_check("ro_particle_newBEGIN");
     RoParticle self;
@@ -22,18 +118,14 @@ RoParticle ro_particle_new_a(int num, const float *vp, rTexture tex_sink, Alloca
     self.num = num;
     self.vp = vp;
 
-    self.L.program = r_program_new_file("res/r/particle.glsl");
-    const int loc_pose = 0;
-    const int loc_uv = 4;
-    const int loc_color = 8;
-    const int loc_sprite_and_sprite_speed = 9;
-    
-    const int loc_speed = 10;
-    const int loc_acc = 11;
-    const int loc_axis_angle = 12;
-    const int loc_color_speed = 13;
-    
-    const int loc_start_time = 14;
+    self.L.program = r_program_new_file_shared("res/r/particle.glsl");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_sprites = glGetUniformLocation(self.L.program, "sprites");
+    self.L.loc_time = glGetUniformLocation(self.L.program, "time");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex"), 0);
 
     self.L.tex = tex_sink;
     self.owns_tex = true;
@@ -41,7 +133,7 @@ RoParticle ro_particle_new_a(int num, const float *vp, rTexture tex_sink, Alloca
     // vao scope
     {
         glGenVertexArrays(1, &self.L.vao);
-        glBindVertexArray(self.L.vao);
+        r_render_bind_vertex_array(self.L.vao);
 
         // vbo
         {
@@ -51,85 +143,15 @@ RoParticle ro_particle_new_a(int num, const float *vp, rTexture tex_sink, Alloca
                          num * sizeof(rParticleRect_s),
                          self.rects,
                          GL_STREAM_DRAW);
-
-            glBindVertexArray(self.L.vao);
-
-            // pose
-            for (int c = 0; c < 4; c++) {
-                int loc = loc_pose + c;
-                glEnableVertexAttribArray(loc);
-                glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
-                                      sizeof(rParticleRect_s), (void *) (c * sizeof(vec4)));
-                glVertexAttribDivisor(loc, 1);
-            }
-
-            // uv
-            for (int c = 0; c < 4; c++) {
-                int loc = loc_uv + c;
-                glEnableVertexAttribArray(loc);
-                glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE,
-                                      sizeof(rParticleRect_s),
-                                      (void *) (offsetof(rParticleRect_s, uv) + c * sizeof(vec4)));
-                glVertexAttribDivisor(loc, 1);
-            }
-            
-
-            // color
-            glEnableVertexAttribArray(loc_color);
-            glVertexAttribPointer(loc_color, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, color));
-            glVertexAttribDivisor(loc_color, 1);
-            
-            // sprite_and_sprite_speed
-            glEnableVertexAttribArray(loc_sprite_and_sprite_speed);
-            glVertexAttribPointer(loc_sprite_and_sprite_speed, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, sprite));
-            glVertexAttribDivisor(loc_sprite_and_sprite_speed, 1);
-
-            // speed
-            glEnableVertexAttribArray(loc_speed);
-            glVertexAttribPointer(loc_speed, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, speed));
-            glVertexAttribDivisor(loc_speed, 1);
-
-            // acc
-            glEnableVertexAttribArray(loc_acc);
-            glVertexAttribPointer(loc_acc, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, acc));
-            glVertexAttribDivisor(loc_acc, 1);
-
-            // axis_angle
-            glEnableVertexAttribArray(loc_axis_angle);
-            glVertexAttribPointer(loc_axis_angle, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, axis_angle));
-            glVertexAttribDivisor(loc_axis_angle, 1);
-
-            // color_speed
-            glEnableVertexAttribArray(loc_color_speed);
-            glVertexAttribPointer(loc_color_speed, 4, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, color_speed));
-            glVertexAttribDivisor(loc_color_speed, 1);
-
-            // start_time
-            glEnableVertexAttribArray(loc_start_time);
-            glVertexAttribPointer(loc_start_time, 1, GL_FLOAT, GL_FALSE,
-                                  sizeof(rParticleRect_s),
-                                  (void *) offsetof(rParticleRect_s, start_time));
-            glVertexAttribDivisor(loc_start_time, 1);
-
-
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
+        setup_attributes(self.L.vbo);
 
-        glBindVertexArray(0);
+        r_render_bind_vertex_array(0);
     }
     
+    self.L.streaming = false;
+    self.L.stream = (rStream) {0};
+
     r_render_error_check("ro_particle_new");
     return self;
 }
@@ -138,9 +160,12 @@ RoParticle ro_particle_new_a(int num, const float *vp, rTexture tex_sink, Alloca
 
 void ro_particle_kill(RoParticle *self) {
     self->L.allocator.free(self->L.allocator, self->rects);
-    glDeleteProgram(self->L.program);
+    r_program_kill_shared(self->L.program);
     glDeleteVertexArrays(1, &self->L.vao);
+    r_render_invalidate_state();
     glDeleteBuffers(1, &self->L.vbo);
+    if (self->L.streaming)
+        r_stream_kill(&self->L.stream);
     if (self->owns_tex)
         r_texture_kill(&self->L.tex);
     *self = (RoParticle) {0};
@@ -148,11 +173,23 @@ void ro_particle_kill(RoParticle *self) {
 
 void ro_particle_update_sub(RoParticle *self, int offset, int size) {
     r_render_error_check("ro_particle_updateBEGIN");
-    glBindBuffer(GL_ARRAY_BUFFER, self->L.vbo);
-
     offset = isca_clamp(offset, 0, self->num-1);
     size = isca_clamp(size, 1, self->num);
 
+    if (self->L.streaming) {
+        // a wrapped range is uploaded as a whole
+        if (offset + size > self->num) {
+            offset = 0;
+            size = self->num;
+        }
+        r_stream_upload_sub(&self->L.stream, self->rects,
+                            offset * sizeof(rParticleRect_s), size * sizeof(rParticleRect_s));
+        r_render_error_check("ro_particle_update");
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, self->L.vbo);
+
     if (offset + size > self->num) {
         int to_end = self->num - offset;
         int from_start = size - to_end;
@@ -179,29 +216,27 @@ void ro_particle_update_sub(RoParticle *self, int offset, int size) {
 
 void ro_particle_render_sub(RoParticle *self, float time, int num) {
     r_render_error_check("ro_particle_renderBEGIN");
-    glUseProgram(self->L.program);
+    r_render_use_program(self->L.program);
 
     // base
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "vp"),
+    glUniformMatrix4fv(self->L.loc_vp,
                        1, GL_FALSE, self->vp);
 
     vec2 sprites = vec2_cast_from_int(&self->L.tex.sprites.v0);
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprites"), 1, &sprites.v0);
+    glUniform2fv(self->L.loc_sprites, 1, &sprites.v0);
     
-    glUniform1f(glGetUniformLocation(self->L.program, "time"), time);
+    glUniform1f(self->L.loc_time, time);
 
-    glUniform1i(glGetUniformLocation(self->L.program, "tex"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
 
     {
-        glBindVertexArray(self->L.vao);
+        r_render_bind_vertex_array(self->L.streaming ? r_stream_vao(self->L.stream) : self->L.vao);
         // r_program_validate(self->L.program); // debug test
         glDrawArraysInstanced(GL_TRIANGLES, 0, 6, num);
-        glBindVertexArray(0);
+        if (self->L.streaming)
+            r_stream_fence(&self->L.stream);
     }
 
-    glUseProgram(0);
     r_render_error_check("ro_particle_render");
 }
 
@@ -210,3 +245,22 @@ void ro_particle_set_texture(RoParticle *self, rTexture tex_sink) {
         r_texture_kill(&self->L.tex);
     self->L.tex = tex_sink;
 }
+
+void ro_particle_set_streaming(RoParticle *self, bool streaming) {
+    if (self->L.streaming == streaming)
+        return;
+    if (!streaming) {
+        r_stream_kill(&self->L.stream);
+        self->L.streaming = false;
+        ro_particle_update(self);
+        return;
+    }
+    self->L.stream = r_stream_new(self->num * sizeof(rParticleRect_s));
+    for (int i = 0; i < R_STREAM_RING; i++) {
+        r_render_bind_vertex_array(self->L.stream.vao[i]);
+        setup_attributes(self->L.stream.vbo[i]);
+    }
+    r_render_bind_vertex_array(0);
+    self->L.streaming = true;
+    ro_particle_update(self);
+}
@@ -12,7 +12,17 @@ RoSingle ro_single_new(const float *vp, rTexture tex_sink) {
 
     self.vp = vp;
 
-    self.L.program = r_program_new_file("res/r/single.glsl");
+    self.L.program = r_program_new_file_shared("res/r/single.glsl");
+    self.L.loc_pose = glGetUniformLocation(self.L.program, "pose");
+    self.L.loc_uv = glGetUniformLocation(self.L.program, "uv");
+    self.L.loc_color = glGetUniformLocation(self.L.program, "color");
+    self.L.loc_sprite = glGetUniformLocation(self.L.program, "sprite");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_sprites = glGetUniformLocation(self.L.program, "sprites");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex"), 0);
     
     self.L.tex = tex_sink;
     self.owns_tex = true;
@@ -25,7 +35,7 @@ RoSingle ro_single_new(const float *vp, rTexture tex_sink) {
 }
 
 void ro_single_kill(RoSingle *self) {
-    glDeleteProgram(self->L.program);
+    r_program_kill_shared(self->L.program);
     if (self->owns_tex)
         r_texture_kill(&self->L.tex);
     *self = (RoSingle) {0};
@@ -34,35 +44,31 @@ void ro_single_kill(RoSingle *self) {
 
 void ro_single_render(RoSingle *self) {
     r_render_error_check("ro_single_renderBEGIN");
-    glUseProgram(self->L.program);
+    r_render_use_program(self->L.program);
 
     // rect
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "pose"), 1, GL_FALSE, &self->rect.pose.m00);
+    glUniformMatrix4fv(self->L.loc_pose, 1, GL_FALSE, &self->rect.pose.m00);
 
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "uv"), 1, GL_FALSE, &self->rect.uv.m00);
+    glUniformMatrix4fv(self->L.loc_uv, 1, GL_FALSE, &self->rect.uv.m00);
 
-    glUniform4fv(glGetUniformLocation(self->L.program, "color"), 1, &self->rect.color.v0);
+    glUniform4fv(self->L.loc_color, 1, &self->rect.color.v0);
     
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprite"), 1, &self->rect.sprite.v0);
+    glUniform2fv(self->L.loc_sprite, 1, &self->rect.sprite.v0);
 
     // base
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "vp"), 1, GL_FALSE, self->vp);
+    glUniformMatrix4fv(self->L.loc_vp, 1, GL_FALSE, self->vp);
     
     vec2 sprites = vec2_cast_from_int(&self->L.tex.sprites.v0);
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprites"), 1, &sprites.v0);
+    glUniform2fv(self->L.loc_sprites, 1, &sprites.v0);
 
-    glUniform1i(glGetUniformLocation(self->L.program, "tex"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
 
     {
-        glBindVertexArray(self->L.vao);
+        r_render_bind_vertex_array(self->L.vao);
 //        r_program_validate(self->L.program); // debug test
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
     }
 
-    glUseProgram(0);
     r_render_error_check("ro_single_render");
 }
 
@@ -20,7 +20,22 @@ RoSingleRefract ro_singlerefract_new(
     self.scale = scale_ptr;
     self.view_aabb = &VIEW_AABB_FULLSCREEN.v0;
 
-    self.L.program = r_program_new_file("res/r/singlerefract.glsl");
+    self.L.program = r_program_new_file_shared("res/r/singlerefract.glsl");
+    self.L.loc_pose = glGetUniformLocation(self.L.program, "pose");
+    self.L.loc_uv = glGetUniformLocation(self.L.program, "uv");
+    self.L.loc_color = glGetUniformLocation(self.L.program, "color");
+    self.L.loc_sprite = glGetUniformLocation(self.L.program, "sprite");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_sprites = glGetUniformLocation(self.L.program, "sprites");
+    self.L.loc_scale = glGetUniformLocation(self.L.program, "scale");
+    self.L.loc_view_aabb = glGetUniformLocation(self.L.program, "view_aabb");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex_main"), 0);
+
+    glUniform1i(glGetUniformLocation(self.L.program, "tex_refract"), 1);
+    glUniform1i(glGetUniformLocation(self.L.program, "tex_framebuffer"), 2);
     
     self.L.tex_main = tex_main_sink;
     self.L.tex_refraction = tex_refraction_sink;
@@ -37,7 +52,7 @@ RoSingleRefract ro_singlerefract_new(
 }
 
 void ro_singlerefract_kill(RoSingleRefract *self) {
-    glDeleteProgram(self->L.program);
+    r_program_kill_shared(self->L.program);
     if (self->owns_tex_main)
         r_texture_kill(&self->L.tex_main);
     if (self->owns_tex_refraction)
@@ -48,49 +63,41 @@ void ro_singlerefract_kill(RoSingleRefract *self) {
 
 void ro_singlerefract_render(RoSingleRefract *self) {
     r_render_error_check("ro_singlerefract_renderBEGIN");
-    glUseProgram(self->L.program);
+    r_render_use_program(self->L.program);
 
     // rect
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "pose"), 1, GL_FALSE, &self->rect.pose.m00);
+    glUniformMatrix4fv(self->L.loc_pose, 1, GL_FALSE, &self->rect.pose.m00);
 
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "uv"), 1, GL_FALSE, &self->rect.uv.m00);
+    glUniformMatrix4fv(self->L.loc_uv, 1, GL_FALSE, &self->rect.uv.m00);
 
-    glUniform4fv(glGetUniformLocation(self->L.program, "color"), 1, &self->rect.color.v0);
+    glUniform4fv(self->L.loc_color, 1, &self->rect.color.v0);
     
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprite"), 1, &self->rect.sprite.v0);
+    glUniform2fv(self->L.loc_sprite, 1, &self->rect.sprite.v0);
 
     // base
-    glUniformMatrix4fv(glGetUniformLocation(self->L.program, "vp"), 1, GL_FALSE, self->vp);
+    glUniformMatrix4fv(self->L.loc_vp, 1, GL_FALSE, self->vp);
     
     vec2 sprites = vec2_cast_from_int(&self->L.tex_main.sprites.v0);
-    glUniform2fv(glGetUniformLocation(self->L.program, "sprites"), 1, &sprites.v0);
+    glUniform2fv(self->L.loc_sprites, 1, &sprites.v0);
 
     
     // fragment shader
-    glUniform1f(glGetUniformLocation(self->L.program, "scale"), *self->scale);
+    glUniform1f(self->L.loc_scale, *self->scale);
     
-    glUniform4fv(glGetUniformLocation(self->L.program, "view_aabb"), 1, self->view_aabb);
+    glUniform4fv(self->L.loc_view_aabb, 1, self->view_aabb);
 
-    glUniform1i(glGetUniformLocation(self->L.program, "tex_main"), 0);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex_main.tex);
+    r_render_bind_texture(0, GL_TEXTURE_2D_ARRAY, self->L.tex_main.tex);
     
-    glUniform1i(glGetUniformLocation(self->L.program, "tex_refract"), 1);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, self->L.tex_refraction.tex);
+    r_render_bind_texture(1, GL_TEXTURE_2D_ARRAY, self->L.tex_refraction.tex);
     
-    glUniform1i(glGetUniformLocation(self->L.program, "tex_framebuffer"), 2);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, self->tex_framebuffer_ptr->tex);
+    r_render_bind_texture(2, GL_TEXTURE_2D, self->tex_framebuffer_ptr->tex);
 
     {
-        glBindVertexArray(self->L.vao);
+        r_render_bind_vertex_array(self->L.vao);
 //        r_program_validate(self->L.program); // debug test
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
     }
 
-    glUseProgram(0);
     r_render_error_check("ro_singlerefract_render");
 }
 
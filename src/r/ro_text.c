@@ -8,36 +8,17 @@
 // private
 //
 
-// from u/pose
-static mat4 u_pose_new(float x, float y, float w, float h) {
-    // mat4 has column major order
-    return (mat4) {{
-                           w, 0, 0, 0,
-                           0, h, 0, 0,
-                           0, 0, 1, 0,
-                           x, y, 0, 1
-                   }};
-}
-
-static mat4 u_pose_new_aa(float l, float t, float w, float h) {
-    return u_pose_new(l + w / 2, t - h / 2, w, h);
-}
-
-static mat4 u_pose_new_hidden() {
-    return u_pose_new(FLT_MAX, FLT_MAX, 1, 1);
-}
-// end of u/pose copy
-
-
-
 static void hide(RoText *self, int from) {
     for (int i = from; i < self->ro.num; i++) {
-        self->ro.rects[i].pose = u_pose_new_hidden();
+        self->ro.rects[i].xy = vec2_set(FLT_MAX);
     }
 }
 
-static mat4 pose(RoText *self, int c, int r) {
-    return u_pose_new_aa(c * self->offset.x, -r * self->offset.y, self->size.x, self->size.y);
+// sets the rect for the character at col, row (top left aligned)
+static void set_pose(RoText *self, rRect2d_s *rect, int c, int r) {
+    rect->size = self->size;
+    rect->xy.x = c * self->offset.x + self->size.x / 2;
+    rect->xy.y = -r * self->offset.y - self->size.y / 2;
 }
 
 
@@ -55,20 +36,20 @@ RoText ro_text_new_a(int max, ro_text_sprite_fn sprite_fn, const float *vp, rTex
     self.vp = vp;
     self.L.mvp = mat4_eye();
     // batch.vp will be set each time before rendering
-    self.ro = ro_batch_new_a(max, NULL, tex_sink, alloc);
+    self.ro = ro_batch2d_new_a(max, NULL, tex_sink, alloc);
     hide(&self, 0);
-    ro_batch_update(&self.ro);
+    ro_batch2d_update(&self.ro);
     return self;
 }
 
 void ro_text_kill(RoText *self) {
-    ro_batch_kill(&self->ro);
+    ro_batch2d_kill(&self->ro);
 }
 
 void ro_text_render(RoText *self) {
     self->L.mvp = mat4_mul_mat(Mat4(self->vp), self->pose);
     self->ro.vp = &self->L.mvp.m00;
-    ro_batch_render(&self->ro);
+    ro_batch2d_render(&self->ro);
 }
 
 vec2 ro_text_set_text(RoText *self, const char *text) {
@@ -77,8 +58,11 @@ vec2 ro_text_set_text(RoText *self, const char *text) {
     int row = 0;
     int cols = 0;
     while (*text && i < self->ro.num) {
-        bool newline = self->sprite_fn(&self->ro.rects[i].sprite, *text);
-        self->ro.rects[i].pose = pose(self, col, row);
+        vec2 sprite;
+        bool newline = self->sprite_fn(&sprite, *text);
+        self->ro.rects[i].sprite.x = sprite.x;
+        self->ro.rects[i].sprite.y = sprite.y;
+        set_pose(self, &self->ro.rects[i], col, row);
 
         col++;
         if (newline) {
@@ -90,7 +74,7 @@ vec2 ro_text_set_text(RoText *self, const char *text) {
         i++;
     }
     hide(self, i);
-    ro_batch_update(&self->ro);
+    ro_batch2d_update(&self->ro);
 
     if (cols == 0)
         return vec2_set(0);
@@ -128,10 +112,15 @@ vec2 ro_text_get_size(RoText *self, const char *text) {
 }
 
 void ro_text_set_color(RoText *self, vec4 color) {
+    color = vec4_clamp(color, 0, 1);
+    ucvec4 c;
+    for(int i=0; i<4; i++) {
+        c.v[i] = (unsigned char) (color.v[i] * 255 + 0.5f);
+    }
     for(int i=0; i<self->ro.num; i++) {
-        self->ro.rects[i].color = color;
+        self->ro.rects[i].color = c;
     }
-    ro_batch_update(&self->ro);
+    ro_batch2d_update(&self->ro);
 }
 
 
@@ -0,0 +1,137 @@
+#include "mathc/float.h"
+#include "rhc/error.h"
+#include "r/render.h"
+#include "r/program.h"
+#include "r/ro_tilemap.h"
+
+
+RoTilemap ro_tilemap_new(int cols, int rows, ivec2 sheet_tiles, const float *vp, rTexture tex_sink) {
+    r_render_error_check("ro_tilemap_newBEGIN");
+    assume(cols > 0 && rows > 0, "tilemap size invalid: %i, %i", cols, rows);
+    RoTilemap self;
+
+    self.pose = mat4_eye();
+    self.uv = mat4_eye();
+    self.color = R_COLOR_WHITE;
+    self.vp = vp;
+    self.slots = NULL;
+
+    self.L.program = r_program_new_file_shared("res/r/tilemap.glsl");
+    self.L.loc_pose = glGetUniformLocation(self.L.program, "pose");
+    self.L.loc_uv = glGetUniformLocation(self.L.program, "uv");
+    self.L.loc_color = glGetUniformLocation(self.L.program, "color");
+    self.L.loc_vp = glGetUniformLocation(self.L.program, "vp");
+    self.L.loc_map_size = glGetUniformLocation(self.L.program, "map_size");
+    self.L.loc_sheet_tiles = glGetUniformLocation(self.L.program, "sheet_tiles");
+    self.L.loc_sheets = glGetUniformLocation(self.L.program, "sheets");
+    self.L.loc_slots = glGetUniformLocation(self.L.program, "slots");
+
+    // samplers use fixed units
+    r_render_use_program(self.L.program);
+    glUniform1i(glGetUniformLocation(self.L.program, "map"), 0);
+
+    glUniform1i(glGetUniformLocation(self.L.program, "tex"), 1);
+
+    self.L.size = (ivec2) {{cols, rows}};
+    self.L.sheet_tiles = sheet_tiles;
+    self.L.tex = tex_sink;
+    self.owns_tex = true;
+    for (int i = 0; i < RO_TILEMAP_MAX_SHEETS; i++)
+        self.L.layers[i] = i;
+
+    // codes are fetched by texel, so no filtering or mipmaps
+    glGenTextures(1, &self.L.map);
+    r_render_bind_texture(0, GL_TEXTURE_2D, self.L.map);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                 cols, rows,
+                 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // needs a vao, even if its empty
+    glGenVertexArrays(1, &self.L.vao);
+
+    r_render_error_check("ro_tilemap_new");
+    return self;
+}
+
+void ro_tilemap_kill(RoTilemap *self) {
+    r_program_kill_shared(self->L.program);
+    glDeleteVertexArrays(1, &self->L.vao);
+    glDeleteTextures(1, &self->L.map);
+    r_render_invalidate_state();
+    if (self->owns_tex)
+        r_texture_kill(&self->L.tex);
+    *self = (RoTilemap) {0};
+}
+
+void ro_tilemap_set(RoTilemap *self, const void *buffer) {
+    ro_tilemap_set_sub(self, buffer, 0, 0, self->L.size.x, self->L.size.y);
+}
+
+void ro_tilemap_set_sub(RoTilemap *self, const void *buffer, int left, int top, int cols, int rows) {
+    r_render_error_check("ro_tilemap_set_subBEGIN");
+    if (!buffer || cols <= 0 || rows <= 0)
+        return;
+
+    // map rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, self->L.size.x);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, left);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, top);
+
+    r_render_bind_texture(0, GL_TEXTURE_2D, self->L.map);
+    glTexSubImage2D(GL_TEXTURE_2D, 0,
+                    left, top, cols, rows,
+                    GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    r_render_error_check("ro_tilemap_set_sub");
+}
+
+void ro_tilemap_render(RoTilemap *self) {
+    r_render_error_check("ro_tilemap_renderBEGIN");
+    r_render_use_program(self->L.program);
+
+    glUniformMatrix4fv(self->L.loc_pose, 1, GL_FALSE, &self->pose.m00);
+
+    glUniformMatrix4fv(self->L.loc_uv, 1, GL_FALSE, &self->uv.m00);
+
+    glUniform4fv(self->L.loc_color, 1, &self->color.v0);
+
+    // base
+    glUniformMatrix4fv(self->L.loc_vp, 1, GL_FALSE, self->vp);
+
+    vec2 map_size = vec2_cast_from_int(&self->L.size.v0);
+    glUniform2fv(self->L.loc_map_size, 1, &map_size.v0);
+
+    vec2 sheet_tiles = vec2_cast_from_int(&self->L.sheet_tiles.v0);
+    glUniform2fv(self->L.loc_sheet_tiles, 1, &sheet_tiles.v0);
+
+    // without slots, the sheet id - 1 is the layer
+    int sheets = self->slots ? RO_TILEMAP_MAX_SHEETS : self->L.tex.sprites.y;
+    glUniform1f(self->L.loc_sheets, sheets < RO_TILEMAP_MAX_SHEETS ? sheets : RO_TILEMAP_MAX_SHEETS);
+    glUniform1iv(self->L.loc_slots, RO_TILEMAP_MAX_SHEETS, self->slots ? self->slots : self->L.layers);
+
+    r_render_bind_texture(0, GL_TEXTURE_2D, self->L.map);
+
+    r_render_bind_texture(1, GL_TEXTURE_2D_ARRAY, self->L.tex.tex);
+
+    {
+        r_render_bind_vertex_array(self->L.vao);
+//        r_program_validate(self->L.program); // debug test
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    r_render_error_check("ro_tilemap_render");
+}
+
+void ro_tilemap_set_texture(RoTilemap *self, rTexture tex_sink) {
+    if (self->owns_tex)
+        r_texture_kill(&self->L.tex);
+    self->L.tex = tex_sink;
+}
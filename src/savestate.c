@@ -1,19 +1,74 @@
 #include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <SDL.h>
 #include "rhc/allocator.h"
+#include "rhc/log.h"
+#include "rhc/time.h"
+#include "u/rle.h"
+#include "u/filemap.h"
 #include "canvas.h"
 #include "palette.h"
 #include "brush.h"
 #include "savestate.h"
 
+// the newest states stay uncompressed, for a fast undo
+#define KEEP_RAW 2
+
+
+//
+// journal file:
+//      JournalHeader
+//      JOURNAL_CHECKPOINT: full data of the delta ids
+//      JOURNAL_STATE records of the states at the checkpoint, followed by new records
+//      records: JournalRecord
+//          JOURNAL_STATE, JOURNAL_CHECKPOINT: uint64_t sizes[id_size], each data aligned to JOURNAL_ALIGN
+//          JOURNAL_UNDO: nothing
+//
+#define JOURNAL_MAGIC 0x4a434c54    // "TLCJ"
+#define JOURNAL_VERSION 2
+#define JOURNAL_ALIGN 8
+enum journal_type {
+    JOURNAL_STATE = 1,
+    JOURNAL_UNDO = 2,
+    JOURNAL_CHECKPOINT = 3
+};
+
+// the journal is rewritten (checkpoint), if it grows larger than 2 * checkpoint_size + JOURNAL_GROW
+#define JOURNAL_GROW (16 * 1024 * 1024)
+
 
 //
 // private
 //
 
+// saved data of an id in a state
+typedef struct {
+    void *data;         // raw or rle encoded data, NULL if spilled
+    size_t size;        // raw size
+    size_t stored_size; // size of the encoded or spilled data
+    bool encoded;
+    bool mapped;        // raw data in the journal map, not owned
+    long file_offset;   // in the spill file, or -1
+} Data;
+
 typedef struct {
-    void *data[SAVESTATE_MAX_IDS];
-    size_t size[SAVESTATE_MAX_IDS];
+    uint32_t magic;
+    uint32_t version;
+    uint64_t checkpoint_size;   // size of the journal, when it was written
+} JournalHeader;
+
+typedef struct {
+    uint32_t type;
+    uint32_t id_size;
+    uint64_t generation;
+} JournalRecord;
+
+typedef struct {
+    Data data[SAVESTATE_MAX_IDS];
     int id_size;
+    int serial;
+    uint64_t generation;
 } State;
 
 
@@ -22,9 +77,427 @@ static struct {
     int state_size;
     savestate_save_fn save_fns[SAVESTATE_MAX_IDS];
     savestate_load_fn load_fns[SAVESTATE_MAX_IDS];
+    savestate_undo_fn undo_fns[SAVESTATE_MAX_IDS];
+    savestate_redo_fn redo_fns[SAVESTATE_MAX_IDS];
     int id_size;
     int current_id;
-} L;
+    int next_serial;
+
+    State *saving;          // target of savestate_save_data
+    bool saving_full;
+    uint64_t generation;    // of the current state
+    uint64_t last_generation;
+
+    size_t memory_budget;
+    size_t memory;          // stored size of all data in memory
+    int compressed_until;   // states[0:compressed_until] are compressed or spilled
+    int spilled_until;      // states[0:spilled_until] are spilled
+
+    FILE *spill_file;
+    long spill_end;
+    bool spill_failed;
+
+    // optional journal of all states
+    FILE *journal;
+    char journal_file[256];
+    size_t journal_size;
+    size_t checkpoint_size;
+
+    // compression in the background, if thread is not NULL
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *work;
+    SDL_cond *done;
+    int busy_serial;        // state compressed by the thread, or 0
+} L = {
+        .memory_budget = SAVESTATE_MEMORY_BUDGET
+};
+
+
+static void data_kill(Data *self) {
+    if (self->mapped)
+        self->data = NULL;
+    if (self->data)
+        L.memory -= self->stored_size;
+    rhc_free(self->data);
+    *self = (Data) {.file_offset = -1};
+}
+
+// returns the raw data, which must be freed if *owned is set, or NULL on an error
+static void *data_load(const Data *self, bool *owned) {
+    *owned = false;
+    if (self->size == 0)
+        return NULL;
+
+    void *stored = self->data;
+    if (self->file_offset >= 0) {
+        stored = rhc_malloc_raising(self->stored_size);
+        if (fseek(L.spill_file, self->file_offset, SEEK_SET) != 0
+            || fread(stored, 1, self->stored_size, L.spill_file) != self->stored_size) {
+            log_error("savestate: failed to read spilled data");
+            rhc_free(stored);
+            return NULL;
+        }
+        *owned = true;
+    }
+    if (!self->encoded)
+        return stored;
+
+    void *raw = rhc_malloc_raising(self->size);
+    bool ok = u_rle_decode(raw, self->size, stored, self->stored_size);
+    if (*owned)
+        rhc_free(stored);
+    *owned = true;
+    if (!ok) {
+        log_error("savestate: failed to decode data");
+        rhc_free(raw);
+        return NULL;
+    }
+    return raw;
+}
+
+// waits until the thread is done with the state, lock must be held
+static void wait_idle(const State *state) {
+    while (L.thread && L.busy_serial != 0 && L.busy_serial == state->serial)
+        SDL_CondWait(L.done, L.lock);
+}
+
+// compresses the oldest uncompressed state, lock must be held
+// if running in the thread, the lock is released while encoding
+// returns false if there is nothing to compress
+static bool compress_next(bool in_thread) {
+    int idx = L.compressed_until;
+    if (idx >= L.state_size - KEEP_RAW)
+        return false;
+
+    // main thread waits on busy states, before killing or spilling them
+    State copy = L.states[idx];
+    L.busy_serial = copy.serial;
+    if (in_thread)
+        SDL_UnlockMutex(L.lock);
+
+    void *encoded[SAVESTATE_MAX_IDS] = {0};
+    size_t encoded_size[SAVESTATE_MAX_IDS] = {0};
+    for (int i = 0; i < copy.id_size; i++) {
+        Data *d = &copy.data[i];
+        if (!d->data || d->encoded || d->mapped || d->size == 0)
+            continue;
+        size_t bound = u_rle_encode_bound(d->size);
+        void *buf = rhc_malloc_raising(bound);
+        size_t size = u_rle_encode(buf, bound, d->data, d->size);
+        if (size == 0 || size >= d->size) {
+            rhc_free(buf);
+            continue;
+        }
+        encoded[i] = rhc_realloc_raising(buf, size);
+        encoded_size[i] = size;
+    }
+
+    if (in_thread)
+        SDL_LockMutex(L.lock);
+
+    // states may have been reallocated
+    State *state = &L.states[idx];
+    for (int i = 0; i < state->id_size; i++) {
+        if (!encoded[i])
+            continue;
+        Data *d = &state->data[i];
+        rhc_free(d->data);
+        L.memory -= d->stored_size;
+        d->data = encoded[i];
+        d->stored_size = encoded_size[i];
+        d->encoded = true;
+        L.memory += d->stored_size;
+    }
+    L.compressed_until = idx + 1;
+    L.busy_serial = 0;
+    if (in_thread)
+        SDL_CondBroadcast(L.done);
+    return true;
+}
+
+static int compress_thread(void *arg) {
+    SDL_LockMutex(L.lock);
+    for (;;) {
+        if (!compress_next(true))
+            SDL_CondWait(L.work, L.lock);
+    }
+    return 0;
+}
+
+// moves the oldest states into the spill file, until the memory budget is reached, lock must be held
+static void spill() {
+    // the newest state stays in memory
+    while (L.memory > L.memory_budget && L.spilled_until < L.state_size - 1 && !L.spill_failed) {
+        if (!L.spill_file) {
+            L.spill_file = tmpfile();
+            if (!L.spill_file) {
+                log_warn("savestate: failed to create a spill file, memory budget ignored");
+                L.spill_failed = true;
+                return;
+            }
+        }
+
+        State *state = &L.states[L.spilled_until];
+        wait_idle(state);
+        for (int i = 0; i < state->id_size; i++) {
+            Data *d = &state->data[i];
+            if (!d->data || d->mapped)
+                continue;
+            if (fseek(L.spill_file, L.spill_end, SEEK_SET) != 0
+                || fwrite(d->data, 1, d->stored_size, L.spill_file) != d->stored_size) {
+                log_warn("savestate: failed to write the spill file, memory budget ignored");
+                L.spill_failed = true;
+                return;
+            }
+            d->file_offset = L.spill_end;
+            L.spill_end += (long) d->stored_size;
+            rhc_free(d->data);
+            d->data = NULL;
+            L.memory -= d->stored_size;
+        }
+        L.spilled_until++;
+    }
+}
+
+
+static bool journal_write(FILE *file, size_t *pos, const void *data, size_t size) {
+    static const char zeros[JOURNAL_ALIGN] = {0};
+    size_t pad = (JOURNAL_ALIGN - *pos % JOURNAL_ALIGN) % JOURNAL_ALIGN;
+    if (fwrite(zeros, 1, pad, file) != pad
+        || fwrite(data, 1, size, file) != size)
+        return false;
+    *pos += pad + size;
+    return true;
+}
+
+// appends a state or checkpoint record with raw or mapped data, lock must be held
+static bool journal_write_state(FILE *file, size_t *pos, const State *state, enum journal_type type) {
+    JournalRecord record = {type, (uint32_t) state->id_size, state->generation};
+    uint64_t sizes[SAVESTATE_MAX_IDS];
+    for (int i = 0; i < state->id_size; i++)
+        sizes[i] = state->data[i].size;
+    if (!journal_write(file, pos, &record, sizeof record)
+        || !journal_write(file, pos, sizes, state->id_size * sizeof(uint64_t)))
+        return false;
+
+    for (int i = 0; i < state->id_size; i++) {
+        bool owned;
+        void *data = data_load(&state->data[i], &owned);
+        bool ok = sizes[i] == 0 || (data && journal_write(file, pos, data, sizes[i]));
+        if (owned)
+            rhc_free(data);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+// saves the full data of the delta ids (of the current generation) into state
+static void save_full(State *state) {
+    *state = (State) {.id_size = L.id_size, .generation = L.generation};
+    for (int i = 0; i < SAVESTATE_MAX_IDS; i++)
+        state->data[i].file_offset = -1;
+    L.saving = state;
+    L.saving_full = true;
+    for (int i = 0; i < L.id_size; i++) {
+        if (!L.undo_fns[i])
+            continue;
+        L.current_id = i;
+        L.save_fns[i]();
+    }
+    L.saving_full = false;
+    L.saving = NULL;
+}
+
+// rewrites the journal with a checkpoint and the current states (without undone ones)
+// if redo is set, the checkpoint is applied with the redo_fns (new generation, for the files)
+static void journal_checkpoint(bool redo) {
+    double time = time_monotonic();
+    State full;
+    save_full(&full);
+
+    char tmp_file[sizeof L.journal_file + 8];
+    snprintf(tmp_file, sizeof tmp_file, "%s.tmp", L.journal_file);
+    FILE *file = fopen(tmp_file, "wb");
+    bool ok = file != NULL;
+    size_t pos = 0;
+    if (ok) {
+        JournalHeader header = {JOURNAL_MAGIC, JOURNAL_VERSION, 0};
+        ok = journal_write(file, &pos, &header, sizeof header)
+             && journal_write_state(file, &pos, &full, JOURNAL_CHECKPOINT);
+        for (int i = 0; ok && i < L.state_size; i++)
+            ok = journal_write_state(file, &pos, &L.states[i], JOURNAL_STATE);
+        header.checkpoint_size = pos;
+        ok = ok && fseek(file, 0, SEEK_SET) == 0
+             && fwrite(&header, sizeof header, 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+    }
+
+    if (redo) {
+        for (int i = 0; i < full.id_size; i++) {
+            if (L.redo_fns[i])
+                L.redo_fns[i](full.data[i].data, full.data[i].size);
+        }
+    }
+    for (int i = 0; i < full.id_size; i++)
+        data_kill(&full.data[i]);
+
+    if (!ok) {
+        // the old journal stays in use
+        log_warn("savestate: journal checkpoint failed: %s", tmp_file);
+        remove(tmp_file);
+        return;
+    }
+
+    // a mapped old journal stays valid
+    if (L.journal)
+        fclose(L.journal);
+    L.journal = NULL;
+    if (rename(tmp_file, L.journal_file) == 0)
+        L.journal = fopen(L.journal_file, "ab");
+    if (!L.journal) {
+        log_error("savestate: failed to open the journal: %s", L.journal_file);
+        return;
+    }
+    L.journal_size = L.checkpoint_size = pos;
+    log_info("savestate: journal checkpoint with %i states (%zu kB) in %.2f ms",
+             L.state_size, pos / 1024, (time_monotonic() - time) * 1000);
+}
+
+static void journal_append(const State *opt_state) {
+    if (!L.journal)
+        return;
+    bool ok;
+    if (opt_state) {
+        ok = journal_write_state(L.journal, &L.journal_size, opt_state, JOURNAL_STATE);
+    } else {
+        JournalRecord record = {JOURNAL_UNDO, 0, L.generation};
+        ok = journal_write(L.journal, &L.journal_size, &record, sizeof record);
+    }
+    // flushed, so a killed process keeps the record
+    if (!ok || fflush(L.journal) != 0) {
+        log_error("savestate: failed to append to the journal, journal closed");
+        fclose(L.journal);
+        L.journal = NULL;
+        return;
+    }
+    if (L.journal_size > 2 * L.checkpoint_size + JOURNAL_GROW)
+        journal_checkpoint(false);
+}
+
+// parses the record at *pos, data points into the map
+// returns false at the end or for a torn or invalid record
+static bool journal_parse(const char *map, size_t size, size_t *pos, JournalRecord *record,
+                          const char **data, uint64_t *sizes) {
+    size_t p = (*pos + JOURNAL_ALIGN - 1) / JOURNAL_ALIGN * JOURNAL_ALIGN;
+    if (p + sizeof *record > size)
+        return false;
+    memcpy(record, map + p, sizeof *record);
+    p += sizeof *record;
+
+    if (record->type == JOURNAL_UNDO) {
+        *pos = p;
+        return true;
+    }
+    if ((record->type != JOURNAL_STATE && record->type != JOURNAL_CHECKPOINT)
+        || record->id_size != (uint32_t) L.id_size)
+        return false;
+
+    p = (p + JOURNAL_ALIGN - 1) / JOURNAL_ALIGN * JOURNAL_ALIGN;
+    if (p + record->id_size * sizeof(uint64_t) > size)
+        return false;
+    memcpy(sizes, map + p, record->id_size * sizeof(uint64_t));
+    p += record->id_size * sizeof(uint64_t);
+
+    for (int i = 0; i < L.id_size; i++) {
+        data[i] = NULL;
+        if (sizes[i] == 0)
+            continue;
+        p = (p + JOURNAL_ALIGN - 1) / JOURNAL_ALIGN * JOURNAL_ALIGN;
+        if (p > size || sizes[i] > size - p)
+            return false;
+        data[i] = map + p;
+        p += sizes[i];
+    }
+    *pos = p;
+    return true;
+}
+
+// returns the number of valid bytes of the journal
+// sets *knows_disk if a checkpoint or state has the disk_generation
+static size_t journal_scan(const char *map, size_t size, uint64_t disk_generation, bool *knows_disk) {
+    *knows_disk = false;
+    JournalHeader header;
+    if (size < sizeof header)
+        return 0;
+    memcpy(&header, map, sizeof header);
+    if (header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION) {
+        log_warn("savestate: journal invalid");
+        return 0;
+    }
+
+    size_t pos = sizeof header;
+    JournalRecord record;
+    const char *data[SAVESTATE_MAX_IDS];
+    uint64_t sizes[SAVESTATE_MAX_IDS];
+    // starts with a checkpoint
+    if (!journal_parse(map, size, &pos, &record, data, sizes) || record.type != JOURNAL_CHECKPOINT)
+        return 0;
+    do {
+        if (record.type != JOURNAL_UNDO) {
+            if (disk_generation != 0 && record.generation == disk_generation)
+                *knows_disk = true;
+            if (record.generation > L.last_generation)
+                L.last_generation = record.generation;
+        }
+    } while (journal_parse(map, size, &pos, &record, data, sizes));
+    return pos;
+}
+
+// applies the records of a scanned journal, the states are pushed as mapped states
+static void journal_replay(const char *map, size_t valid) {
+    size_t pos = sizeof(JournalHeader);
+    JournalRecord record;
+    const char *data[SAVESTATE_MAX_IDS];
+    uint64_t sizes[SAVESTATE_MAX_IDS];
+    while (journal_parse(map, valid, &pos, &record, data, sizes)) {
+        if (record.type == JOURNAL_UNDO) {
+            if (L.state_size <= 1)
+                continue;
+            State *state = &L.states[--L.state_size];
+            L.generation = L.states[L.state_size - 1].generation;
+            for (int i = 0; i < state->id_size; i++) {
+                Data *d = &state->data[i];
+                if (L.undo_fns[i] && d->size > 0)
+                    L.undo_fns[i](d->data, d->size);
+                data_kill(d);
+            }
+            continue;
+        }
+
+        State state = {.id_size = L.id_size, .generation = record.generation};
+        for (int i = 0; i < L.id_size; i++) {
+            state.data[i].file_offset = -1;
+            if (sizes[i] == 0)
+                continue;
+            state.data[i].data = (void *) data[i];
+            state.data[i].size = state.data[i].stored_size = sizes[i];
+            state.data[i].mapped = true;
+        }
+        L.generation = record.generation;
+        for (int i = 0; i < L.id_size; i++) {
+            if (L.redo_fns[i] && sizes[i] > 0)
+                L.redo_fns[i](data[i], sizes[i]);
+        }
+        if (record.type == JOURNAL_CHECKPOINT)
+            continue;
+
+        state.serial = ++L.next_serial;
+        L.states = rhc_realloc_raising(L.states, ++L.state_size * sizeof(State));
+        L.states[L.state_size - 1] = state;
+    }
+}
 
 
 //
@@ -32,7 +505,13 @@ static struct {
 //
 
 void savestate_init() {
-
+    L.lock = SDL_CreateMutex();
+    L.work = SDL_CreateCond();
+    L.done = SDL_CreateCond();
+    if (L.lock && L.work && L.done)
+        L.thread = SDL_CreateThread(compress_thread, "savestate", NULL);
+    if (!L.thread)
+        log_warn("savestate: no compress thread, compressing synchronously");
 }
 
 int savestate_register(savestate_save_fn save_fn, savestate_load_fn load_fn) {
@@ -41,39 +520,140 @@ int savestate_register(savestate_save_fn save_fn, savestate_load_fn load_fn) {
 
     L.save_fns[id] = save_fn;
     L.load_fns[id] = load_fn;
+    L.undo_fns[id] = NULL;
+    L.redo_fns[id] = NULL;
+
+    return id;
+}
+
+int savestate_register_delta(savestate_save_fn save_fn, savestate_undo_fn undo_fn, savestate_redo_fn redo_fn) {
+    int id = L.id_size++;
+    assert(L.id_size <= SAVESTATE_MAX_IDS);
+
+    L.save_fns[id] = save_fn;
+    L.load_fns[id] = NULL;
+    L.undo_fns[id] = undo_fn;
+    L.redo_fns[id] = redo_fn;
 
     return id;
 }
 
+bool savestate_saving_full() {
+    return L.saving_full;
+}
+
+uint64_t savestate_generation() {
+    return L.generation;
+}
+
+bool savestate_journal_open(const char *file, uint64_t disk_generation) {
+    double time = time_monotonic();
+    SDL_LockMutex(L.lock);
+    assume(L.state_size == 0 && !L.journal, "journal must be opened before the first save");
+    snprintf(L.journal_file, sizeof L.journal_file, "%s", file);
+    L.generation = L.last_generation = disk_generation;
+
+    // stays mapped until the app is closed (used by the restored states)
+    uFileMap map = u_filemap_new(file);
+    bool knows_disk = false;
+    size_t valid = u_filemap_valid(map) ? journal_scan(map.data, map.size, disk_generation, &knows_disk) : 0;
+
+    if (valid > 0 && knows_disk) {
+        journal_replay(map.data, valid);
+        JournalHeader header;
+        memcpy(&header, map.data, sizeof header);
+        L.checkpoint_size = header.checkpoint_size;
+        L.journal_size = map.size;
+        if (valid < map.size) {
+            log_warn("savestate: journal has a torn or invalid tail, ignored %zu bytes", map.size - valid);
+            journal_checkpoint(false);
+        } else if (L.journal_size > 2 * L.checkpoint_size + JOURNAL_GROW) {
+            journal_checkpoint(false);
+        } else {
+            L.journal = fopen(file, "ab");
+            if (!L.journal)
+                log_error("savestate: failed to open the journal: %s", file);
+        }
+    } else {
+        if (u_filemap_valid(map)) {
+            log_warn("savestate: journal does not know the files on disk (generation %llu), restarted",
+                     (unsigned long long) disk_generation);
+        }
+        u_filemap_kill(&map);
+        // new generation for the files
+        L.generation = ++L.last_generation;
+        journal_checkpoint(true);
+    }
+
+    int restored = L.state_size;
+    if (restored > 0) {
+        State *state = &L.states[L.state_size - 1];
+        for (int i = 0; i < state->id_size; i++) {
+            if (L.load_fns[i])
+                L.load_fns[i](state->data[i].data, state->data[i].size);
+        }
+    }
+    SDL_UnlockMutex(L.lock);
+
+    log_info("savestate: journal restored %i states in %.2f ms", restored, (time_monotonic() - time) * 1000);
+    return restored > 0;
+}
+
+void savestate_set_memory_budget(size_t bytes) {
+    SDL_LockMutex(L.lock);
+    L.memory_budget = bytes;
+    spill();
+    SDL_UnlockMutex(L.lock);
+}
+
 void savestate_save_data(const void *data, size_t size) {
-    if(L.current_id <0 || L.state_size <= 0) {
+    if(L.current_id <0 || !L.saving) {
         log_error("savestate: save_data failed");
         return;
     }
-    State *state = &L.states[L.state_size - 1];
+    Data *d = &L.saving->data[L.current_id];
+    data_kill(d);
     if (size > 0) {
-        state->data[L.current_id] = rhc_malloc_raising(size);
-        memcpy(state->data[L.current_id], data, size);
-        state->size[L.current_id] = size;
-    } else
-        state->size[L.current_id] = 0;
+        d->data = rhc_malloc_raising(size);
+        memcpy(d->data, data, size);
+        d->size = d->stored_size = size;
+        L.memory += size;
+    }
 }
 
 void savestate_save() {
     log_info("savestate_save: %d", L.state_size);
+    SDL_LockMutex(L.lock);
 
     L.state_size++;
     L.states = rhc_realloc_raising(L.states, L.state_size * sizeof(State));
 
     State *state = &L.states[L.state_size - 1];
     *state = (State) {0};
+    for (int i = 0; i < SAVESTATE_MAX_IDS; i++)
+        state->data[i].file_offset = -1;
 
     state->id_size = L.id_size;
+    state->serial = ++L.next_serial;
+    state->generation = L.generation = ++L.last_generation;
 
+    L.saving = state;
     for (int i = 0; i < L.id_size; i++) {
         L.current_id = i;
         L.save_fns[i]();
     }
+    L.saving = NULL;
+    journal_append(state);
+
+    if (L.thread) {
+        SDL_CondSignal(L.work);
+    } else {
+        while (compress_next(false));
+    }
+    spill();
+
+    log_info("savestate_save: memory: %zu kB", L.memory / 1024);
+    SDL_UnlockMutex(L.lock);
 }
 
 void savestate_undo() {
@@ -83,22 +663,50 @@ void savestate_undo() {
         log_error("savestate_undo failed");
         return;
     }
+    SDL_LockMutex(L.lock);
 
-    // kill last state
+    // revert deltas and kill last state
     State *state = &L.states[L.state_size - 1];
+    L.generation = L.states[L.state_size - 2].generation;
+    wait_idle(state);
     for (int i = 0; i < state->id_size; i++) {
-        rhc_free(state->data[i]);
+        Data *d = &state->data[i];
+        if (L.undo_fns[i]) {
+            bool owned;
+            void *data = data_load(d, &owned);
+            if (data || d->size == 0)
+                L.undo_fns[i](data, d->size);
+            if (owned)
+                rhc_free(data);
+        }
+        // spilled in order, so the last state is at the end of the file
+        if (d->file_offset >= 0 && d->file_offset < L.spill_end)
+            L.spill_end = d->file_offset;
+        data_kill(d);
     }
     *state = (State) {0};
 
     // reduce states by one
     L.state_size--;
+    if (L.compressed_until > L.state_size)
+        L.compressed_until = L.state_size;
+    if (L.spilled_until > L.state_size)
+        L.spilled_until = L.state_size;
+    journal_append(NULL);
 
     // undo new last state
     state = &L.states[L.state_size - 1];
     for (int i = 0; i < state->id_size; i++) {
-        L.load_fns[i](state->data[i], state->size[i]);
+        if (!L.load_fns[i])
+            continue;
+        bool owned;
+        void *data = data_load(&state->data[i], &owned);
+        if (data || state->data[i].size == 0)
+            L.load_fns[i](data, state->data[i].size);
+        if (owned)
+            rhc_free(data);
     }
+    SDL_UnlockMutex(L.lock);
 }
 
 void savestate_redo_id(int savestate_id) {
@@ -108,6 +716,17 @@ void savestate_redo_id(int savestate_id) {
         log_error("savestate_redo failed");
         return;
     }
-    State *state = &L.states[L.state_size - 1];
-    L.load_fns[savestate_id](state->data[savestate_id], state->size[savestate_id]);
+    if (!L.load_fns[savestate_id]) {
+        log_error("savestate_redo failed, delta state");
+        return;
+    }
+    SDL_LockMutex(L.lock);
+    Data *d = &L.states[L.state_size - 1].data[savestate_id];
+    bool owned;
+    void *data = data_load(d, &owned);
+    if (data || d->size == 0)
+        L.load_fns[savestate_id](data, d->size);
+    if (owned)
+        rhc_free(data);
+    SDL_UnlockMutex(L.lock);
 }
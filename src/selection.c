@@ -1,5 +1,6 @@
 #include "rhc/error.h"
 #include "rhc/log.h"
+#include "canvas.h"
 #include "selection.h"
 
 
@@ -97,6 +98,7 @@ void selection_cut(uImage from, int layer, uColor_s replace) {
             *u_image_pixel(from, c + L.left, r + L.top, layer) = replace;
         }
     }
+    canvas_mark_dirty(L.left, L.top, L.cols, L.rows);
 }
 
 void selection_paste(uImage to, int layer) {
@@ -118,6 +120,7 @@ void selection_paste(uImage to, int layer) {
                     *u_image_pixel(L.opt_img, c, r, 0);
         }
     }
+    canvas_mark_dirty(L.left, L.top, L.cols, L.rows);
 }
 
 void selection_rotate(bool right) {
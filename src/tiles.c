@@ -1,36 +1,365 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL.h>
 #include "r/texture.h"
+#include "u/filemap.h"
 #include "rhc/error.h"
+#include "rhc/allocator.h"
+#include "rhc/time.h"
 #include "tiles.h"
 
+#define SHEET_COLS ((int) (TILES_COLS * TILES_SIZE))
+#define SHEET_ROWS ((int) (TILES_ROWS * TILES_SIZE))
+#define SHEET_SIZE (SHEET_COLS * SHEET_ROWS * sizeof(uColor_s))
+
+//
+// cache file of decoded sheets:
+//      CacheHeader
+//      CacheEntry[MAX_TILES]
+//      sheet pixels[MAX_TILES], at CACHE_PIXELS + i * SHEET_SIZE
+// an entry is valid, if path, size and mtime equal the sheet file
+// the mapped cache is never written, new entries are written into CACHE_TMP_FILE, which replaces it
+//
+#define CACHE_FILE "tiles/tiles.cache"
+#define CACHE_TMP_FILE "tiles/tiles.cache.tmp"
+#define CACHE_MAGIC 0x43544c54      // "TLTC"
+#define CACHE_VERSION 1
+#define CACHE_PIXELS 32768
+
 
 struct TilesGlobals_s tiles;
 
-void tiles_init() {
-    int tile_id = 1;
-    tiles.size = 0;
+
+//
+// private
+//
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sheet_cols, sheet_rows;
+} CacheHeader;
+
+typedef struct {
+    char file[128];
+    int64_t size;
+    int64_t mtime;
+    uint32_t valid;
+    uint32_t padding;
+} CacheEntry;
+
+_Static_assert(TILES_MEMORY_BUDGET >= MAX_TILES * SHEET_SIZE, "default budget fits all sheets");
+_Static_assert(sizeof(CacheHeader) + MAX_TILES * sizeof(CacheEntry) <= CACHE_PIXELS, "cache pixels offset");
+
+static struct {
+    char files[MAX_TILES][128];
+    bool loader_ready;
+
+    // lru of the gpu slots
+    size_t memory_budget;
+    int slots_size;             // allocated layers of tiles.sheets
+    int slots_used;             // usable slots, limited by the budget
+    int slot_sheets[MAX_TILES]; // sheet in each slot, or -1
+    unsigned used[MAX_TILES];   // tick of the last tiles_require of each sheet
+    unsigned tick;              // frame counter of tiles_update
+    bool budget_warned;         // sheets are required each frame, so warn only once per budget
+
+    // sheets to decode
+    int jobs[MAX_TILES];
+    int jobs_size;
+    uImage decoded[MAX_TILES];
+    SDL_atomic_t next_job;
+
+    uFileMap cache;
+    bool cache_opened;
+} L = {
+        .memory_budget = TILES_MEMORY_BUDGET,
+        .tick = 1
+};
+
+static int budget_slots() {
+    size_t slots = L.memory_budget / SHEET_SIZE;
+    if (slots < 1)
+        slots = 1;
+    return slots < (size_t) tiles.size ? (int) slots : tiles.size;
+}
+
+static void evict_slot(int slot) {
+    int sheet = L.slot_sheets[slot];
+    if (sheet < 0)
+        return;
+    tiles.slots[sheet] = -1;
+    L.slot_sheets[slot] = -1;
+    tiles.evictions++;
+}
+
+// returns a free slot, or the slot of the least recently required sheet (not of the current frame)
+// returns -1 if all slots are used by sheets of the current frame
+static int acquire_slot() {
+    int lru = -1;
+    for (int slot = 0; slot < L.slots_used; slot++) {
+        int sheet = L.slot_sheets[slot];
+        if (sheet < 0)
+            return slot;
+        if (L.used[sheet] != L.tick && (lru < 0 || L.used[sheet] < L.used[L.slot_sheets[lru]]))
+            lru = slot;
+    }
+    if (lru >= 0)
+        evict_slot(lru);
+    return lru;
+}
+
+// uploads the pixels of the sheet into a slot
+static bool upload_sheet(int i, const void *pixels) {
+    int slot = acquire_slot();
+    if (slot < 0) {
+        if (!L.budget_warned)
+            log_warn("tiles: memory budget too small for the required sheets, sheet %i not loaded", i + 1);
+        L.budget_warned = true;
+        return false;
+    }
+    r_texture_set_sprite(tiles.sheets, 0, slot, pixels);
+    L.slot_sheets[slot] = i;
+    tiles.slots[i] = slot;
+    return true;
+}
+
+static CacheHeader cache_header_new() {
+    return (CacheHeader) {CACHE_MAGIC, CACHE_VERSION, SHEET_COLS, SHEET_ROWS};
+}
+
+static void cache_open() {
+    L.cache_opened = true;
+    L.cache = u_filemap_new(CACHE_FILE);
+    CacheHeader header = cache_header_new();
+    if (!u_filemap_valid(L.cache))
+        return;
+    if (L.cache.size < CACHE_PIXELS || memcmp(L.cache.data, &header, sizeof header) != 0) {
+        log_warn("tiles: cache invalid, recreated");
+        u_filemap_kill(&L.cache);
+    }
+}
+
+// returns the decoded pixels of the sheet, or NULL if not cached
+static const void *cache_get(int i, const struct stat *st) {
+    if (!u_filemap_valid(L.cache) || L.cache.size < CACHE_PIXELS + (i + 1) * SHEET_SIZE)
+        return NULL;
+    CacheEntry entry;
+    memcpy(&entry, L.cache.data + sizeof(CacheHeader) + i * sizeof(CacheEntry), sizeof entry);
+    if (!entry.valid
+        || strncmp(entry.file, L.files[i], sizeof entry.file) != 0
+        || entry.size != (int64_t) st->st_size
+        || entry.mtime != (int64_t) st->st_mtime)
+        return NULL;
+    return L.cache.data + CACHE_PIXELS + i * SHEET_SIZE;
+}
+
+static bool cache_write_at(FILE *file, size_t pos, const void *data, size_t size) {
+    return fseek(file, (long) pos, SEEK_SET) == 0
+           && fwrite(data, 1, size, file) == size;
+}
+
+// rewrites the cache with the valid entries of the mapped cache and the new ones (pixels[i] != NULL)
+static void cache_put(const struct stat *stats, const void *const *pixels) {
+    FILE *file = fopen(CACHE_TMP_FILE, "wb");
+    if (!file) {
+        log_warn("tiles: failed to open the cache: %s", CACHE_TMP_FILE);
+        return;
+    }
+
+    CacheHeader header = cache_header_new();
+    CacheEntry entries[MAX_TILES] = {0};
+    bool ok = cache_write_at(file, 0, &header, sizeof header);
+    for (int i = 0; ok && i < MAX_TILES; i++) {
+        const void *data = pixels[i];
+        if (data) {
+            entries[i] = (CacheEntry) {.size = stats[i].st_size, .mtime = stats[i].st_mtime, .valid = 1};
+            snprintf(entries[i].file, sizeof entries[i].file, "%s", L.files[i]);
+        } else if (u_filemap_valid(L.cache) && L.cache.size >= CACHE_PIXELS + (i + 1) * SHEET_SIZE) {
+            memcpy(&entries[i], L.cache.data + sizeof(CacheHeader) + i * sizeof(CacheEntry), sizeof entries[i]);
+            data = entries[i].valid ? L.cache.data + CACHE_PIXELS + i * SHEET_SIZE : NULL;
+        }
+        if (data)
+            ok = cache_write_at(file, CACHE_PIXELS + i * SHEET_SIZE, data, SHEET_SIZE);
+    }
+    ok = ok && cache_write_at(file, sizeof header, entries, sizeof entries);
+    ok = fclose(file) == 0 && ok;
+
+    // the old map is released before it is replaced (windows can not rename over a mapped file)
+    u_filemap_kill(&L.cache);
+    if (ok) {
+        remove(CACHE_FILE);
+        ok = rename(CACHE_TMP_FILE, CACHE_FILE) == 0;
+    }
+    if (!ok) {
+        log_warn("tiles: failed to write the cache: %s", CACHE_FILE);
+        remove(CACHE_TMP_FILE);
+    }
+    L.cache = u_filemap_new(CACHE_FILE);
+}
+
+// decodes the next sheets, until all jobs are taken
+static int decode_worker(void *arg) {
     for (;;) {
-        char file[128];
-        sprintf(file, "tiles/tile_%02i.png", tile_id);
+        int job = SDL_AtomicAdd(&L.next_job, 1);
+        if (job >= L.jobs_size)
+            return 0;
+        int i = L.jobs[job];
+        L.decoded[i] = u_image_new_file(2, L.files[i]);
+    }
+}
+
 
-        uImage img = u_image_new_file(2, file);
-        if (!u_image_valid(img))
+//
+// public
+//
+
+void tiles_init() {
+    // discover the sheets, tile_01.png, tile_02.png, ...
+    tiles.size = 0;
+    for (int i = 0; i < MAX_TILES; i++)
+        tiles.slots[i] = L.slot_sheets[i] = -1;
+    while (tiles.size < MAX_TILES) {
+        char *file = L.files[tiles.size];
+        snprintf(file, sizeof L.files[0], "tiles/tile_%02i.png", tiles.size + 1);
+        SDL_RWops *rw = SDL_RWFromFile(file, "rb");
+        if (!rw)
             break;
+        SDL_RWclose(rw);
+        tiles.ids[tiles.size] = tiles.size + 1;
+        tiles.size++;
+    }
 
-        assume(img.cols == TILES_COLS * TILES_SIZE
-               && img.rows == TILES_ROWS * TILES_SIZE,
-               "wrong tiles size");
+    log_info("tiles: found %i", tiles.size);
+    if (tiles.size == 0) {
+        log_error("tiles: WARNING: 0 tiles found! Put some into tiles/tile_xx.png, starting with xx=01");
+        tiles.sheets = r_texture_new_invalid();
+        return;
+    }
 
-        rTexture tex = r_texture_new(img.cols, img.rows, TILES_COLS, TILES_ROWS, u_image_layer(img, 0));
+    // slots are filled on demand
+    L.slots_size = L.slots_used = budget_slots();
+    tiles.sheets = r_texture_new_empty(SHEET_COLS, SHEET_ROWS * L.slots_size, 1, L.slots_size);
+    log_info("tiles: %i slots for %i sheets", L.slots_size, tiles.size);
+}
 
+void tiles_update() {
+    L.tick++;
+}
 
-        tiles.imgs[tiles.size] = img;
-        tiles.textures[tiles.size] = tex;
-        tiles.ids[tiles.size] = tile_id;
+void tiles_set_memory_budget(size_t bytes) {
+    L.memory_budget = bytes;
+    L.budget_warned = false;
+    if (L.slots_size == 0)
+        return;
+    int slots = budget_slots();
+    if (slots > L.slots_size)
+        slots = L.slots_size;
+    for (int slot = slots; slot < L.slots_used; slot++)
+        evict_slot(slot);
+    L.slots_used = slots;
+}
 
-        tile_id++;
-        tiles.size++;
+void tiles_require(const int *tile_ids, int n) {
+    L.jobs_size = 0;
+    for (int k = 0; k < n; k++) {
+        int i = tile_ids[k] - 1;
+        if (i < 0 || i >= tiles.size || L.used[i] == L.tick)
+            continue;
+        L.used[i] = L.tick;
+        if (tiles.slots[i] >= 0)
+            continue;
+        // failed sheets are retried in the next frame
+        L.jobs[L.jobs_size++] = i;
+    }
+    if (L.jobs_size == 0)
+        return;
+
+    // slots of sheets required in this frame are not available, so sheets that do not fit are not decoded
+    int available = 0;
+    for (int slot = 0; slot < L.slots_used; slot++) {
+        int sheet = L.slot_sheets[slot];
+        if (sheet < 0 || L.used[sheet] != L.tick)
+            available++;
+    }
+    if (L.jobs_size > available) {
+        if (!L.budget_warned)
+            log_warn("tiles: %i sheets required, but the memory budget has %i slots", L.jobs_size, L.slots_used);
+        L.budget_warned = true;
+        L.jobs_size = available;
+        if (L.jobs_size == 0)
+            return;
+    }
+
+    double time = time_monotonic();
+    if (!L.cache_opened)
+        cache_open();
+
+    // cached sheets are uploaded directly from the map
+    struct stat stats[MAX_TILES];
+    bool has_stats[MAX_TILES];
+    int cached = 0;
+    for (int job = 0; job < L.jobs_size; job++) {
+        int i = L.jobs[job];
+        has_stats[i] = stat(L.files[i], &stats[i]) == 0;
+        const void *pixels = has_stats[i] ? cache_get(i, &stats[i]) : NULL;
+        if (!pixels)
+            continue;
+        if (upload_sheet(i, pixels))
+            cached++;
+        L.jobs[job--] = L.jobs[--L.jobs_size];
     }
-    log_info("tiles: loaded %i", tiles.size);
-    if (tiles.size == 0)
-        log_error("tiles: WARNING: 0 tiles loaded! Put some into tiles/tile_xx.png, starting with xx=01");
+    if (L.jobs_size == 0) {
+        log_info("tiles: loaded %i sheets from the cache in %.1f ms",
+                 cached, (time_monotonic() - time) * 1000);
+        return;
+    }
+
+    // the first one on this thread, so that the image loader is initialized
+    int start = 0;
+    if (!L.loader_ready) {
+        L.decoded[L.jobs[0]] = u_image_new_file(2, L.files[L.jobs[0]]);
+        L.loader_ready = true;
+        start = 1;
+    }
+    SDL_AtomicSet(&L.next_job, start);
+
+    int cpus = SDL_GetCPUCount();
+    int remaining = L.jobs_size - start;
+    int workers = cpus - 1 < remaining - 1 ? cpus - 1 : remaining - 1;
+    SDL_Thread *pool[MAX_TILES];
+    int pool_size = 0;
+    for (int i = 0; i < workers; i++) {
+        pool[pool_size] = SDL_CreateThread(decode_worker, "tiles decode", NULL);
+        if (pool[pool_size])
+            pool_size++;
+    }
+    decode_worker(NULL);
+    for (int i = 0; i < pool_size; i++)
+        SDL_WaitThread(pool[i], NULL);
+
+    // uploads on this thread, the cpu copies are not kept
+    const void *put[MAX_TILES] = {0};
+    bool has_put = false;
+    for (int job = 0; job < L.jobs_size; job++) {
+        int i = L.jobs[job];
+        uImage *img = &L.decoded[i];
+        if (u_image_valid(*img) && img->cols == SHEET_COLS && img->rows == SHEET_ROWS) {
+            upload_sheet(i, u_image_layer(*img, 0));
+            if (has_stats[i]) {
+                put[i] = u_image_layer(*img, 0);
+                has_put = true;
+            }
+        } else
+            log_error("tiles: failed to load or wrong size: %s", L.files[i]);
+    }
+    if (has_put)
+        cache_put(stats, put);
+    for (int job = 0; job < L.jobs_size; job++)
+        u_image_kill(&L.decoded[L.jobs[job]]);
+
+    log_info("tiles: loaded %i sheets in %.1f ms (decoded %i on %i threads)",
+             cached + L.jobs_size, (time_monotonic() - time) * 1000, L.jobs_size, pool_size + 1);
 }
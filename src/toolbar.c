@@ -3,6 +3,7 @@
 #include "r/ro_text.h"
 #include "u/pose.h"
 #include "mathc/float.h"
+#include "mathc/int.h"
 #include "button.h"
 #include "camera.h"
 #include "brush.h"
@@ -56,6 +57,7 @@ static struct {
 
     //non tools:
     RoSingle shape;
+    RoText shape_radius;
     float shape_minus_time, shape_plus_time;
 
     RoSingle color_bg, color_drop;
@@ -134,6 +136,25 @@ static mat4 pose16(float col, float row) {
     return pose_wh(col, row, 16, 16);
 }
 
+// the shape selector continues after the kernels with the circle radii
+#define SHAPE_SELECTOR_SIZE (BRUSH_NUM_SHAPES + BRUSH_MAX_CIRCLE_RADIUS)
+
+static int shape_selector_get() {
+    if (brush.circle_radius > 0)
+        return BRUSH_NUM_SHAPES - 1 + brush.circle_radius;
+    return brush.shape;
+}
+
+static void shape_selector_set(int index) {
+    index = isca_clamp(index, 0, SHAPE_SELECTOR_SIZE - 1);
+    if (index < BRUSH_NUM_SHAPES) {
+        brush.shape = index;
+        brush.circle_radius = 0;
+    } else {
+        brush.circle_radius = index - BRUSH_NUM_SHAPES + 1;
+    }
+}
+
 
 //
 // public
@@ -170,6 +191,9 @@ void toolbar_init() {
     // shape kernel:
     L.shape = ro_single_new(camera.gl, brushshape_create_kernel_texture(U_COLOR_TRANSPARENT, U_COLOR_WHITE));
 
+    // circle radius, shown instead of the kernel:
+    L.shape_radius = ro_text_new_font55(2, camera.gl);
+
     // secondar color:
     L.color_bg = ro_single_new(camera.gl, r_texture_new_file(1, 1, "res/toolbar_color_bg.png"));
 
@@ -222,6 +246,13 @@ void toolbar_update(float dtime) {
     // shape kernel:
     L.shape.rect.pose = pose16(-22, 10);  // should be 16x16
     L.shape.rect.sprite.y = brush.shape;
+    if (brush.circle_radius > 0) {
+        char radius[8];
+        sprintf(radius, "%d", brush.circle_radius);
+        vec2 radius_size = ro_text_set_text(&L.shape_radius, radius);
+        vec2 center = u_pose_get_xy(L.shape.rect.pose);
+        u_pose_set_xy(&L.shape_radius.pose, floorf(center.x - radius_size.x / 2), floorf(center.y + radius_size.y / 2));
+    }
 
     // secondary color:    
     L.color_bg.rect.pose = L.color_drop.rect.pose = pose16(64, 9);
@@ -273,7 +304,7 @@ void toolbar_update(float dtime) {
     if (button_is_pressed(L.shape_minus)) {
         L.shape_minus_time += dtime;
         if (L.shape_minus_time > LONG_PRESS_TIME) {
-            brush.shape = 0;
+            shape_selector_set(0);
         }
     } else
         L.shape_minus_time = 0;
@@ -281,7 +312,7 @@ void toolbar_update(float dtime) {
     if (button_is_pressed(L.shape_plus)) {
         L.shape_plus_time += dtime;
         if (L.shape_plus_time > LONG_PRESS_TIME) {
-            brush.shape = BRUSH_NUM_SHAPES - 1;
+            shape_selector_set(SHAPE_SELECTOR_SIZE - 1);
         }
     } else
         L.shape_plus_time = 0;
@@ -299,7 +330,10 @@ void toolbar_render() {
     }
 
     // shape kernel;
-    ro_single_render(&L.shape);
+    if (brush.circle_radius > 0)
+        ro_text_render(&L.shape_radius);
+    else
+        ro_single_render(&L.shape);
 
     // secondary color:
     ro_single_render(&L.color_bg);
@@ -439,16 +473,12 @@ bool toolbar_pointer_event(ePointer_s pointer) {
 
     if (button_clicked(L.shape_minus, pointer)) {
         log_info("toolbar: shape_minus");
-        brush.shape--;
-        if (brush.shape < 0)
-            brush.shape = 0;
+        shape_selector_set(shape_selector_get() - 1);
     }
 
     if (button_clicked(L.shape_plus, pointer)) {
         log_info("toolbar: shape_plus");
-        brush.shape++;
-        if (brush.shape >= BRUSH_NUM_SHAPES)
-            brush.shape = BRUSH_NUM_SHAPES - 1;
+        shape_selector_set(shape_selector_get() + 1);
     }
 
 
@@ -0,0 +1,53 @@
+#include "rhc/allocator.h"
+#include "rhc/file.h"
+#include "u/filemap.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define USE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+//
+// public
+//
+
+uFileMap u_filemap_new(const char *file) {
+#ifdef USE_MMAP
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        return u_filemap_new_invalid();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return u_filemap_new_invalid();
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return u_filemap_new_invalid();
+    return (uFileMap) {map, st.st_size};
+#else
+    String content = file_read(file, false);
+    if (!string_valid(content) || content.size == 0) {
+        string_kill(&content);
+        return u_filemap_new_invalid();
+    }
+    return (uFileMap) {content.data, content.size};
+#endif
+}
+
+void u_filemap_kill(uFileMap *self) {
+    // invalid safe
+    if (u_filemap_valid(*self)) {
+#ifdef USE_MMAP
+        munmap((void *) self->data, self->size);
+#else
+        rhc_free((void *) self->data);
+#endif
+    }
+    *self = u_filemap_new_invalid();
+}
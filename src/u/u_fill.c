@@ -0,0 +1,130 @@
+#include <string.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#include "mathc/types/int.h"
+#include "mathc/sca/int.h"
+#include "u/fill.h"
+
+
+//
+// private
+//
+
+#define TYPE ivec2
+#define CLASS PosStack
+#define FN_NAME posstack
+#include "rhc/dynarray.h"
+
+
+//
+// public
+//
+
+bool u_fill_replace_row(uColor_s *row, int n, uColor_s from, uColor_s to) {
+    uint32_t f, t;
+    memcpy(&f, &from, sizeof f);
+    memcpy(&t, &to, sizeof t);
+    bool changed = false;
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i vf = _mm_set1_epi32((int) f);
+    __m128i vt = _mm_set1_epi32((int) t);
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) &row[i]);
+        __m128i mask = _mm_cmpeq_epi32(v, vf);
+        if (!_mm_movemask_epi8(mask))
+            continue;
+        v = _mm_or_si128(_mm_and_si128(mask, vt), _mm_andnot_si128(mask, v));
+        _mm_storeu_si128((__m128i *) &row[i], v);
+        changed = true;
+    }
+#elif defined(__ARM_NEON)
+    uint32x4_t vf = vdupq_n_u32(f);
+    uint32x4_t vt = vdupq_n_u32(t);
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t v = vld1q_u32((const uint32_t *) &row[i]);
+        uint32x4_t mask = vceqq_u32(v, vf);
+        uint32x2_t any = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+        if (!(vget_lane_u32(any, 0) | vget_lane_u32(any, 1)))
+            continue;
+        vst1q_u32((uint32_t *) &row[i], vbslq_u32(mask, vt, v));
+        changed = true;
+    }
+#endif
+    for (; i < n; i++) {
+        uint32_t v;
+        memcpy(&v, &row[i], sizeof v);
+        if (v != f)
+            continue;
+        memcpy(&row[i], &t, sizeof t);
+        changed = true;
+    }
+    return changed;
+}
+
+bool u_fill_spans(uImage img, int layer, int seed_c, int seed_r, uColor_s color, bool mode8,
+                  int left, int top, int right, int bottom,
+                  int *out_left, int *out_top, int *out_cols, int *out_rows) {
+    if (seed_c < left || seed_c >= right || seed_r < top || seed_r >= bottom)
+        return false;
+    uColor_s target = *u_image_pixel(img, seed_c, seed_r, layer);
+    // the fill color differs from the target color, so filled pixels are not visited again
+    if (u_color_equals(target, color))
+        return false;
+    int d = mode8 ? 1 : 0;
+
+    int dirty_left = right, dirty_top = bottom, dirty_right = left, dirty_bottom = top;
+
+    // PosStack needs to be killed
+    // holds a single seed for each span, not each pixel
+    PosStack stack = posstack_new(32);
+    posstack_push(&stack, (ivec2) {{seed_c, seed_r}});
+
+    while (stack.size > 0) {
+        ivec2 p = posstack_pop(&stack);
+        uColor_s *row = u_image_pixel(img, 0, p.y, layer);
+        if (!u_color_equals(row[p.x], target))
+            continue;
+
+        int l = p.x, r = p.x;
+        while (l > left && u_color_equals(row[l - 1], target))
+            l--;
+        while (r < right - 1 && u_color_equals(row[r + 1], target))
+            r++;
+        for (int c = l; c <= r; c++)
+            row[c] = color;
+
+        dirty_left = isca_min(dirty_left, l);
+        dirty_right = isca_max(dirty_right, r + 1);
+        dirty_top = isca_min(dirty_top, p.y);
+        dirty_bottom = isca_max(dirty_bottom, p.y + 1);
+
+        // seed each run of target pixels in the rows above and below
+        int scan_l = isca_max(l - d, left);
+        int scan_r = isca_min(r + d, right - 1);
+        for (int y = p.y - 1; y <= p.y + 1; y += 2) {
+            if (y < top || y >= bottom)
+                continue;
+            const uColor_s *next = u_image_pixel(img, 0, y, layer);
+            bool in_run = false;
+            for (int c = scan_l; c <= scan_r; c++) {
+                bool match = u_color_equals(next[c], target);
+                if (match && !in_run)
+                    posstack_push(&stack, (ivec2) {{c, y}});
+                in_run = match;
+            }
+        }
+    }
+
+    posstack_kill(&stack);
+
+    *out_left = dirty_left;
+    *out_top = dirty_top;
+    *out_cols = dirty_right - dirty_left;
+    *out_rows = dirty_bottom - dirty_top;
+    return true;
+}
@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <string.h>
+#include "rhc/log.h"
+#include "u/rle.h"
+
+//
+// packets of an uint32 header:
+//      header & RUN_BIT: run of (header & ~RUN_BIT) times the next word
+//      else: header words follow
+// the src_size % 4 tail bytes are copied at the end
+//
+
+
+//
+// private
+//
+
+#define RUN_BIT 0x80000000u
+#define MAX_COUNT 0x7fffffffu
+#define MIN_RUN 3
+
+static uint32_t word(const char *data, size_t index) {
+    uint32_t w;
+    memcpy(&w, data + index * 4, 4);
+    return w;
+}
+
+static bool put(char *dst, size_t dst_size, size_t *pos, const void *data, size_t size) {
+    if (*pos + size > dst_size)
+        return false;
+    memcpy(dst + *pos, data, size);
+    *pos += size;
+    return true;
+}
+
+
+//
+// public
+//
+
+size_t u_rle_encode(void *dst, size_t dst_size, const void *src, size_t src_size) {
+    const char *in = src;
+    char *out = dst;
+    size_t words = src_size / 4;
+    size_t pos = 0;
+
+    size_t i = 0;
+    while (i < words) {
+        // literal until the next run
+        size_t lit_end = i;
+        size_t run = 0;
+        while (lit_end < words && lit_end - i < MAX_COUNT) {
+            uint32_t w = word(in, lit_end);
+            run = 1;
+            while (lit_end + run < words && run < MAX_COUNT && word(in, lit_end + run) == w)
+                run++;
+            if (run >= MIN_RUN)
+                break;
+            lit_end += run;
+            run = 0;
+        }
+        if (lit_end - i > MAX_COUNT)
+            lit_end = i + MAX_COUNT;
+
+        if (lit_end > i) {
+            uint32_t header = (uint32_t) (lit_end - i);
+            if (!put(out, dst_size, &pos, &header, 4)
+                || !put(out, dst_size, &pos, in + i * 4, header * 4))
+                return 0;
+            i = lit_end;
+        }
+        if (run >= MIN_RUN) {
+            uint32_t header = RUN_BIT | (uint32_t) run;
+            if (!put(out, dst_size, &pos, &header, 4)
+                || !put(out, dst_size, &pos, in + i * 4, 4))
+                return 0;
+            i += run;
+        }
+    }
+
+    if (!put(out, dst_size, &pos, in + words * 4, src_size % 4))
+        return 0;
+    return pos;
+}
+
+bool u_rle_decode(void *dst, size_t dst_size, const void *src, size_t src_size) {
+    const char *in = src;
+    char *out = dst;
+    size_t tail = dst_size % 4;
+    if (src_size < tail) {
+        log_error("u_rle_decode failed: invalid src");
+        return false;
+    }
+    size_t in_end = src_size - tail;
+    size_t out_end = dst_size - tail;
+
+    size_t in_pos = 0, out_pos = 0;
+    while (in_pos < in_end) {
+        uint32_t header;
+        if (in_pos + 4 > in_end)
+            break;
+        memcpy(&header, in + in_pos, 4);
+        in_pos += 4;
+
+        size_t count = header & MAX_COUNT;
+        if (header & RUN_BIT) {
+            if (in_pos + 4 > in_end || out_pos + count * 4 > out_end)
+                break;
+            for (size_t i = 0; i < count; i++)
+                memcpy(out + out_pos + i * 4, in + in_pos, 4);
+            in_pos += 4;
+        } else {
+            if (in_pos + count * 4 > in_end || out_pos + count * 4 > out_end)
+                break;
+            memcpy(out + out_pos, in + in_pos, count * 4);
+            in_pos += count * 4;
+        }
+        out_pos += count * 4;
+    }
+
+    if (in_pos != in_end || out_pos != out_end) {
+        log_error("u_rle_decode failed: invalid src");
+        return false;
+    }
+    memcpy(out + out_pos, in + in_end, tail);
+    return true;
+}
@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "rhc/error.h"
+#include "rhc/log.h"
+#include "u/rle.h"
+#include "u/filemap.h"
+#include "u/tilemap.h"
+
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define USE_FSYNC
+#endif
+
+
+//
+// file:
+//      Header
+//      2 index slots: Index + Chunk[layers][chunks_y][chunks_x]
+//          the valid slot with the newer generation is used,
+//          a save writes the other slot, so a torn write keeps the last index
+//      payloads, aligned to ALIGN, replaced payloads are appended (garbage)
+//
+
+//
+// private
+//
+
+#define MAGIC 0x4d434c54    // "TLCM"
+#define VERSION 2
+#define ALIGN 8
+#define SLOTS 2
+
+enum chunk_encoding {
+    CHUNK_EMPTY = 0,
+    CHUNK_RAW = 1,
+    CHUNK_RLE = 2
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t cols, rows, layers;
+    uint32_t chunk_size;
+} Header;
+
+typedef struct {
+    uint64_t generation;    // of the write, 0 for an unused slot
+    uint64_t garbage;       // bytes of replaced payloads
+    uint64_t end;           // end of the last payload
+    uint64_t tag;           // user value
+    uint32_t checksum;      // of this struct (with checksum 0) and the chunks
+    uint32_t padding;
+} Index;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t encoding;
+} Chunk;
+
+typedef struct {
+    int x, y, cols, rows;   // in pixels
+} ChunkRect;
+
+static int chunks_x(const Header *h) {
+    return (int) ((h->cols + h->chunk_size - 1) / h->chunk_size);
+}
+
+static int chunks_y(const Header *h) {
+    return (int) ((h->rows + h->chunk_size - 1) / h->chunk_size);
+}
+
+static size_t chunks_num(const Header *h) {
+    return (size_t) h->layers * chunks_x(h) * chunks_y(h);
+}
+
+static ChunkRect chunk_rect(const Header *h, int cx, int cy) {
+    ChunkRect r = {cx * h->chunk_size, cy * h->chunk_size, h->chunk_size, h->chunk_size};
+    if (r.x + r.cols > (int) h->cols)
+        r.cols = h->cols - r.x;
+    if (r.y + r.rows > (int) h->rows)
+        r.rows = h->rows - r.y;
+    return r;
+}
+
+static Header header_new(uImage img) {
+    return (Header) {MAGIC, VERSION, img.cols, img.rows, img.layers, U_TILEMAP_CHUNK_SIZE};
+}
+
+static bool header_valid(const Header *h) {
+    return h->magic == MAGIC && h->version == VERSION
+           && h->cols > 0 && h->rows > 0 && h->layers > 0 && h->chunk_size > 0;
+}
+
+static bool header_fits(const Header *h, uImage img) {
+    return h->cols == (uint32_t) img.cols && h->rows == (uint32_t) img.rows
+           && h->layers == (uint32_t) img.layers;
+}
+
+static size_t align(size_t pos) {
+    return (pos + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+static size_t slot_offset(const Header *h, int slot) {
+    return sizeof(Header) + slot * (sizeof(Index) + chunks_num(h) * sizeof(Chunk));
+}
+
+static size_t payloads_begin(const Header *h) {
+    return slot_offset(h, SLOTS);
+}
+
+// fnv1a
+static uint32_t checksum_add(uint32_t hash, const void *data, size_t size) {
+    const unsigned char *it = data;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ it[i]) * 16777619u;
+    return hash;
+}
+
+static uint32_t index_checksum(Index index, const Chunk *chunks, size_t num) {
+    index.checksum = 0;
+    uint32_t hash = checksum_add(2166136261u, &index, sizeof index);
+    return checksum_add(hash, chunks, num * sizeof(Chunk));
+}
+
+// checks the checksum and that all chunks are within the file
+static bool index_valid(const Header *h, const Index *index, const Chunk *chunks, size_t file_size) {
+    size_t num = chunks_num(h);
+    if (index->generation == 0 || index->end > file_size
+        || index_checksum(*index, chunks, num) != index->checksum)
+        return false;
+    for (size_t i = 0; i < num; i++) {
+        const Chunk *c = &chunks[i];
+        bool ok = c->encoding == CHUNK_EMPTY
+                  || ((c->encoding == CHUNK_RAW || c->encoding == CHUNK_RLE)
+                      && c->offset >= payloads_begin(h)
+                      && c->offset <= index->end && c->size <= index->end - c->offset);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+// flushes the file to the disk
+static bool sync_file(FILE *file) {
+    if (fflush(file) != 0)
+        return false;
+#ifdef USE_FSYNC
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// gathers the chunk into raw and encodes it
+// returns the payload (raw or encoded) and sets size and encoding of chunk
+static const void *encode_chunk(uImage img, ChunkRect r, int layer, uColor_s *raw,
+                                void *encoded, size_t encoded_cap, Chunk *chunk) {
+    bool empty = true;
+    for (int row = 0; row < r.rows; row++) {
+        uColor_s *src = u_image_pixel(img, r.x, r.y + row, layer);
+        uColor_s *dst = raw + row * r.cols;
+        memcpy(dst, src, r.cols * sizeof(uColor_s));
+        for (int c = 0; empty && c < r.cols; c++)
+            empty = dst[c].r == 0 && dst[c].g == 0 && dst[c].b == 0 && dst[c].a == 0;
+    }
+
+    size_t raw_size = (size_t) r.cols * r.rows * sizeof(uColor_s);
+    if (empty) {
+        *chunk = (Chunk) {0, 0, CHUNK_EMPTY};
+        return NULL;
+    }
+    size_t size = u_rle_encode(encoded, encoded_cap, raw, raw_size);
+    if (size > 0 && size < raw_size) {
+        *chunk = (Chunk) {0, (uint32_t) size, CHUNK_RLE};
+        return encoded;
+    }
+    *chunk = (Chunk) {0, (uint32_t) raw_size, CHUNK_RAW};
+    return raw;
+}
+
+static bool write_at(FILE *file, size_t pos, const void *data, size_t size) {
+    return fseek(file, (long) pos, SEEK_SET) == 0
+           && fwrite(data, 1, size, file) == size;
+}
+
+// writes all chunks in file.tmp and renames it
+static bool save_full(uImage self, const char *file, uint64_t tag) {
+    char tmp_file[256];
+    snprintf(tmp_file, sizeof tmp_file, "%s.tmp", file);
+    FILE *f = fopen(tmp_file, "wb");
+    if (!f) {
+        log_error("u_tilemap_save_file failed: could not open: %s", tmp_file);
+        return false;
+    }
+
+    Header h = header_new(self);
+    size_t num = chunks_num(&h);
+    Chunk *index = rhc_malloc_raising(num * sizeof(Chunk));
+    size_t raw_size = (size_t) h.chunk_size * h.chunk_size * sizeof(uColor_s);
+    size_t encoded_cap = u_rle_encode_bound(raw_size);
+    uColor_s *raw = rhc_malloc_raising(raw_size);
+    void *encoded = rhc_malloc_raising(encoded_cap);
+
+    bool ok = true;
+    size_t pos = payloads_begin(&h);
+    Chunk *chunk = index;
+    for (int layer = 0; ok && layer < self.layers; layer++) {
+        for (int cy = 0; ok && cy < chunks_y(&h); cy++) {
+            for (int cx = 0; ok && cx < chunks_x(&h); cx++, chunk++) {
+                const void *payload = encode_chunk(self, chunk_rect(&h, cx, cy), layer,
+                                                   raw, encoded, encoded_cap, chunk);
+                if (chunk->encoding == CHUNK_EMPTY)
+                    continue;
+                pos = align(pos);
+                chunk->offset = pos;
+                ok = write_at(f, pos, payload, chunk->size);
+                pos += chunk->size;
+            }
+        }
+    }
+    // second slot stays unused (zeros)
+    Index idx = {1, 0, pos, tag};
+    idx.checksum = index_checksum(idx, index, num);
+    Index unused = {0};
+    ok = ok && write_at(f, 0, &h, sizeof h)
+         && write_at(f, slot_offset(&h, 0), &idx, sizeof idx)
+         && write_at(f, slot_offset(&h, 0) + sizeof idx, index, num * sizeof(Chunk))
+         && write_at(f, slot_offset(&h, 1), &unused, sizeof unused)
+         && sync_file(f);
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp_file, file) == 0;
+
+    rhc_free(index);
+    rhc_free(raw);
+    rhc_free(encoded);
+    if (!ok)
+        log_error("u_tilemap_save_file failed: %s", file);
+    return ok;
+}
+
+// reads the newest valid index slot of the file (from the map or the file)
+// returns the slot or -1, chunks must have the size of chunks_num
+static int read_index(const Header *h, const char *opt_map, FILE *opt_file, size_t file_size,
+                      Index *out_index, Chunk *chunks) {
+    size_t num = chunks_num(h);
+    int slot = -1;
+    for (int i = 0; i < SLOTS; i++) {
+        size_t offset = slot_offset(h, i);
+        if (offset + sizeof(Index) + num * sizeof(Chunk) > file_size)
+            continue;
+        Index index;
+        Chunk *dst = slot < 0 ? chunks : chunks + num;  // second buffer for the compare
+        if (opt_map) {
+            memcpy(&index, opt_map + offset, sizeof index);
+            memcpy(dst, opt_map + offset + sizeof index, num * sizeof(Chunk));
+        } else if (fseek(opt_file, (long) offset, SEEK_SET) != 0
+                   || fread(&index, sizeof index, 1, opt_file) != 1
+                   || fread(dst, sizeof(Chunk), num, opt_file) != num) {
+            continue;
+        }
+        if (!index_valid(h, &index, dst, file_size))
+            continue;
+        if (slot < 0 || index.generation > out_index->generation) {
+            if (slot >= 0)
+                memcpy(chunks, dst, num * sizeof(Chunk));
+            *out_index = index;
+            slot = i;
+        }
+    }
+    return slot;
+}
+
+
+//
+// public
+//
+
+bool u_tilemap_load_file(uImage self, const char *file, uint64_t *opt_out_tag) {
+    uFileMap fm = u_filemap_new(file);
+    if (!u_filemap_valid(fm))
+        return false;
+    const char *map = fm.data;
+    size_t size = fm.size;
+
+    Header h;
+    Index index;
+    Chunk *chunks = NULL;
+    bool ok = size >= sizeof h;
+    if (ok) {
+        memcpy(&h, map, sizeof h);
+        ok = header_valid(&h) && header_fits(&h, self);
+    }
+    if (ok) {
+        chunks = rhc_malloc_raising(2 * chunks_num(&h) * sizeof(Chunk));
+        ok = read_index(&h, map, NULL, size, &index, chunks) >= 0;
+    }
+    if (!ok) {
+        rhc_error = "tilemap load file failed";
+        log_warn("u_tilemap_load_file failed: invalid, torn or other size: %s", file);
+        rhc_free(chunks);
+        u_filemap_kill(&fm);
+        return false;
+    }
+
+    uColor_s *raw = NULL;
+    const Chunk *chunk = chunks;
+    for (int layer = 0; ok && layer < self.layers; layer++) {
+        for (int cy = 0; ok && cy < chunks_y(&h); cy++) {
+            for (int cx = 0; ok && cx < chunks_x(&h); cx++, chunk++) {
+                ChunkRect r = chunk_rect(&h, cx, cy);
+                size_t raw_size = (size_t) r.cols * r.rows * sizeof(uColor_s);
+                const uColor_s *src;
+                if (chunk->encoding == CHUNK_EMPTY) {
+                    src = NULL;
+                } else if (chunk->encoding == CHUNK_RAW) {
+                    // read directly from the map
+                    ok = chunk->size == raw_size;
+                    src = (const uColor_s *) (map + chunk->offset);
+                } else {
+                    if (!raw)
+                        raw = rhc_malloc_raising((size_t) h.chunk_size * h.chunk_size * sizeof(uColor_s));
+                    ok = u_rle_decode(raw, raw_size, map + chunk->offset, chunk->size);
+                    src = raw;
+                }
+                for (int row = 0; ok && row < r.rows; row++) {
+                    uColor_s *dst = u_image_pixel(self, r.x, r.y + row, layer);
+                    if (src)
+                        memcpy(dst, src + row * r.cols, r.cols * sizeof(uColor_s));
+                    else
+                        memset(dst, 0, r.cols * sizeof(uColor_s));
+                }
+            }
+        }
+    }
+    rhc_free(raw);
+    rhc_free(chunks);
+    u_filemap_kill(&fm);
+
+    if (!ok) {
+        rhc_error = "tilemap load file failed";
+        log_error("u_tilemap_load_file failed: invalid chunks: %s", file);
+        memset(self.data, 0, u_image_data_size(self));
+        return false;
+    }
+    if (opt_out_tag)
+        *opt_out_tag = index.tag;
+    return true;
+}
+
+bool u_tilemap_save_file_region(uImage self, const char *file, int left, int top, int cols, int rows,
+                                uint64_t tag) {
+    if (!u_image_valid(self)) {
+        rhc_error = "tilemap save file failed";
+        log_error("u_tilemap_save_file failed: invalid image");
+        return false;
+    }
+
+    FILE *f = fopen(file, "r+b");
+    if (!f)
+        return save_full(self, file, tag);
+
+    Header h;
+    if (fread(&h, sizeof h, 1, f) != 1 || !header_valid(&h) || !header_fits(&h, self)
+        || h.chunk_size != U_TILEMAP_CHUNK_SIZE) {
+        fclose(f);
+        return save_full(self, file, tag);
+    }
+
+    long file_size = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    size_t num = chunks_num(&h);
+    Index index;
+    Chunk *chunks = rhc_malloc_raising(2 * num * sizeof(Chunk));
+    int slot = file_size > 0 ? read_index(&h, NULL, f, (size_t) file_size, &index, chunks) : -1;
+    if (slot < 0 || index.garbage > index.end / 2) {
+        // invalid or too fragmented
+        rhc_free(chunks);
+        fclose(f);
+        return save_full(self, file, tag);
+    }
+
+    size_t raw_size = (size_t) h.chunk_size * h.chunk_size * sizeof(uColor_s);
+    size_t encoded_cap = u_rle_encode_bound(raw_size);
+    uColor_s *raw = rhc_malloc_raising(raw_size);
+    void *encoded = rhc_malloc_raising(encoded_cap);
+
+    int cx_begin = left < 0 ? 0 : left / (int) h.chunk_size;
+    int cy_begin = top < 0 ? 0 : top / (int) h.chunk_size;
+    int cx_end = (left + cols + (int) h.chunk_size - 1) / (int) h.chunk_size;
+    int cy_end = (top + rows + (int) h.chunk_size - 1) / (int) h.chunk_size;
+    cx_end = cx_end > chunks_x(&h) ? chunks_x(&h) : cx_end;
+    cy_end = cy_end > chunks_y(&h) ? chunks_y(&h) : cy_end;
+
+    // new payloads are appended, the old ones stay valid for the current index
+    bool ok = true;
+    size_t pos = index.end;
+    for (int layer = 0; ok && layer < self.layers; layer++) {
+        for (int cy = cy_begin; ok && cy < cy_end; cy++) {
+            for (int cx = cx_begin; ok && cx < cx_end; cx++) {
+                Chunk *chunk = &chunks[((size_t) layer * chunks_y(&h) + cy) * chunks_x(&h) + cx];
+                index.garbage += chunk->size;
+                const void *payload = encode_chunk(self, chunk_rect(&h, cx, cy), layer,
+                                                   raw, encoded, encoded_cap, chunk);
+                if (chunk->encoding == CHUNK_EMPTY)
+                    continue;
+                pos = align(pos);
+                chunk->offset = pos;
+                ok = write_at(f, pos, payload, chunk->size);
+                pos += chunk->size;
+            }
+        }
+    }
+
+    // payloads must be on the disk, before the other slot references them
+    index.generation++;
+    index.end = pos;
+    index.tag = tag;
+    index.checksum = index_checksum(index, chunks, num);
+    size_t offset = slot_offset(&h, (slot + 1) % SLOTS);
+    ok = ok && sync_file(f)
+         && write_at(f, offset, &index, sizeof index)
+         && write_at(f, offset + sizeof index, chunks, num * sizeof(Chunk))
+         && sync_file(f);
+    ok = fclose(f) == 0 && ok;
+
+    rhc_free(chunks);
+    rhc_free(raw);
+    rhc_free(encoded);
+    if (!ok) {
+        rhc_error = "tilemap save file failed";
+        log_error("u_tilemap_save_file failed: %s", file);
+    }
+    return ok;
+}
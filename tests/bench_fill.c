@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include "rhc/rhc_impl.h"
+#include "rhc/time.h"
+#include "mathc/types/int.h"
+#include "u/prandom.h"
+#include "u/fill.h"
+
+//
+// microbenchmark of the old per pixel flood fill against u_fill_spans
+// usage: bench_fill [size], default is a 4096 x 4096 map
+// returns 1 if the results differ
+//
+
+#define TYPE ivec2
+#define CLASS PixelStack
+#define FN_NAME pixelstack
+#include "rhc/dynarray.h"
+
+
+// the fill of brushmode_fill before the span fill: a stack of 4 (8) neighbours per painted pixel
+static void fill_pixels(uImage img, int layer, int seed_c, int seed_r, uColor_s color, bool mode8) {
+    uColor_s target = *u_image_pixel(img, seed_c, seed_r, layer);
+    if (u_color_equals(target, color))
+        return;
+
+    PixelStack stack = pixelstack_new(32);
+    pixelstack_push(&stack, (ivec2) {{seed_c, seed_r}});
+
+    while (stack.size > 0) {
+        ivec2 p = pixelstack_pop(&stack);
+
+        // as brush_draw_pixel with shading
+        if (!u_image_contains(img, p.x, p.y))
+            continue;
+        uColor_s *pixel = u_image_pixel(img, p.x, p.y, layer);
+        if (!u_color_equals(*pixel, target))
+            continue;
+        *pixel = color;
+
+        pixelstack_push(&stack, (ivec2) {{p.x - 1, p.y}});
+        pixelstack_push(&stack, (ivec2) {{p.x + 1, p.y}});
+        pixelstack_push(&stack, (ivec2) {{p.x, p.y - 1}});
+        pixelstack_push(&stack, (ivec2) {{p.x, p.y + 1}});
+        if (!mode8)
+            continue;
+        pixelstack_push(&stack, (ivec2) {{p.x - 1, p.y - 1}});
+        pixelstack_push(&stack, (ivec2) {{p.x + 1, p.y - 1}});
+        pixelstack_push(&stack, (ivec2) {{p.x - 1, p.y + 1}});
+        pixelstack_push(&stack, (ivec2) {{p.x + 1, p.y + 1}});
+    }
+    pixelstack_kill(&stack);
+}
+
+static void fill_spans(uImage img, int layer, int seed_c, int seed_r, uColor_s color, bool mode8) {
+    int l, t, c, r;
+    u_fill_spans(img, layer, seed_c, seed_r, color, mode8, 0, 0, img.cols, img.rows, &l, &t, &c, &r);
+}
+
+static uImage image_new(int size) {
+    uImage img = {
+            .data = rhc_malloc_raising((size_t) size * size * sizeof(uColor_s)),
+            .cols = size, .rows = size, .layers = 1,
+            .allocator = allocator_new_raising()
+    };
+    return img;
+}
+
+// empty map, or walls with the given percentage
+static void image_setup(uImage img, int walls) {
+    u_pseed(42);
+    uColor_s wall = {255, 0, 0, 255};
+    uColor_s empty = {0, 0, 0, 0};
+    for (int i = 0; i < img.cols * img.rows; i++)
+        img.data[i] = (int) (u_prand() % 100) < walls ? wall : empty;
+    img.data[img.cols / 2 + img.rows / 2 * img.cols] = empty;
+}
+
+typedef void (*fill_fn)(uImage img, int layer, int seed_c, int seed_r, uColor_s color, bool mode8);
+
+static double run(fill_fn fn, uImage img, int walls, bool mode8) {
+    image_setup(img, walls);
+    uColor_s color = {0, 0, 255, 255};
+    double time = time_monotonic();
+    fn(img, 0, img.cols / 2, img.rows / 2, color, mode8);
+    return (time_monotonic() - time) * 1000;
+}
+
+int main(int argc, char **argv) {
+    int size = argc > 1 ? atoi(argv[1]) : 4096;
+    if (size <= 0) {
+        printf("usage: bench_fill [size]\n");
+        return 1;
+    }
+    uImage a = image_new(size);
+    uImage b = image_new(size);
+    bool equal = true;
+
+    printf("bench_fill: %i x %i map\n", size, size);
+    printf("%-8s %-6s %12s %12s %8s\n", "walls", "mode", "pixels ms", "spans ms", "speedup");
+    int walls[] = {0, 20, 40};
+    for (int w = 0; w < 3; w++) {
+        for (int mode8 = 0; mode8 <= 1; mode8++) {
+            double t_pixels = run(fill_pixels, a, walls[w], mode8);
+            double t_spans = run(fill_spans, b, walls[w], mode8);
+            bool same = memcmp(a.data, b.data, (size_t) size * size * sizeof(uColor_s)) == 0;
+            equal = equal && same;
+            printf("%6i %%  %-6s %12.2f %12.2f %7.1fx%s\n", walls[w], mode8 ? "8" : "4",
+                   t_pixels, t_spans, t_pixels / t_spans, same ? "" : "  RESULTS DIFFER");
+        }
+    }
+
+    rhc_free(a.data);
+    rhc_free(b.data);
+    return equal ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include "rhc/rhc_impl.h"
+#include "rhc/time.h"
+#include "mathc/float.h"
+#include "e/definitions.h"
+#include "u/pose.h"
+#include "r/r.h"
+
+//
+// benchmark of the streaming batch (r/stream.h) against the glBufferSubData path, over N frames
+// usage: bench_stream [frames], run it from the build dir (needs res/r/*.glsl)
+// each frame updates the rects (all, or a sub range) and renders them into a small framebuffer.
+// the first frames are read back and compared, returns 1 if the stream renders differently
+//
+
+#define RECTS 20000
+#define SIZE 64
+#define CHECK_FRAMES 12
+
+
+static void fill(RoBatch *self, int frame, int offset, int size) {
+    for (int i = offset; i < offset + size; i++) {
+        u_pose_set(&self->rects[i].pose,
+                   sinf(i * 0.1f + frame * 0.3f) * 0.8f, cosf(i * 0.07f + frame * 0.2f) * 0.8f,
+                   0.05f, 0.05f, 0);
+        self->rects[i].color = (vec4) {{(i % 7) / 7.0f, (frame % 5) / 5.0f, 0.5f, 1}};
+    }
+}
+
+// sub ranges move through the batch and wrap around
+static void frame_range(int frame, bool sub, int *offset, int *size) {
+    *offset = sub ? (frame * (RECTS / 7)) % RECTS : 0;
+    *size = sub ? RECTS / 8 : RECTS;
+}
+
+static void update(RoBatch *self, int frame, bool sub) {
+    int offset, size;
+    frame_range(frame, sub, &offset, &size);
+    int to_end = offset + size > RECTS ? RECTS - offset : size;
+    fill(self, frame, offset, to_end);
+    fill(self, frame, 0, size - to_end);
+    ro_batch_update_sub(self, offset, size);
+}
+
+static void render(RoBatch *self, void *opt_pixels) {
+    glClear(GL_COLOR_BUFFER_BIT);
+    ro_batch_render(self);
+    if (opt_pixels)
+        glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, opt_pixels);
+}
+
+static bool check(RoBatch *stream, RoBatch *subdata, bool sub) {
+    static unsigned char a[SIZE][SIZE][4], b[SIZE][SIZE][4];
+    int bad = 0;
+    for (int frame = 0; frame < CHECK_FRAMES; frame++) {
+        update(subdata, frame, sub);
+        update(stream, frame, sub);
+        render(subdata, a);
+        render(stream, b);
+        if (memcmp(a, b, sizeof a) != 0)
+            bad++;
+    }
+    if (bad > 0)
+        printf("bench_stream: %i of %i frames differ (%s)\n", bad, CHECK_FRAMES, sub ? "sub" : "full");
+    return bad == 0;
+}
+
+static void bench(RoBatch *self, const char *name, int frames, bool sub) {
+    int orphaned = self->L.stream.orphaned;
+    long long uploaded = self->L.stream.uploaded;
+    glFinish();
+    double update_time = 0;
+    double time = time_monotonic();
+    for (int frame = 0; frame < frames; frame++) {
+        double t = time_monotonic();
+        update(self, frame, sub);
+        update_time += time_monotonic() - t;
+        render(self, NULL);
+        glFlush();
+    }
+    glFinish();
+    printf("%-16s %10.3f %10.3f", name,
+           (time_monotonic() - time) * 1000 / frames, update_time * 1000 / frames);
+    if (self->L.streaming)
+        printf(" %10i %10.1f", self->L.stream.orphaned - orphaned,
+               (self->L.stream.uploaded - uploaded) / 1024.0 / frames);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 300;
+    if (frames <= 0) {
+        printf("usage: bench_stream [frames]\n");
+        return 1;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        log_error("bench_stream: SDL_Init failed: %s", SDL_GetError());
+        return 1;
+    }
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, E_GL_MAJOR_VERSION);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, E_GL_MINOR_VERSION);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, E_GL_PROFILE);
+    SDL_Window *window = SDL_CreateWindow("bench_stream", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                          SIZE, SIZE, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext context = window ? SDL_GL_CreateContext(window) : NULL;
+    if (!context) {
+        log_error("bench_stream: no gl context: %s", SDL_GetError());
+        return 1;
+    }
+#ifdef OPTION_GLEW
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        log_error("bench_stream: glewInit failed");
+        return 1;
+    }
+#endif
+    r_render_init(window);
+
+    rFramebuffer fb = r_framebuffer_new(SIZE, SIZE);
+    r_framebuffer_begin(fb);
+
+    mat4 vp = mat4_eye();
+    unsigned char white[4] = {255, 255, 255, 255};
+    RoBatch subdata = ro_batch_new(RECTS, &vp.m00, r_texture_new(1, 1, 1, 1, white));
+    RoBatch stream = ro_batch_new(RECTS, &vp.m00, r_texture_new(1, 1, 1, 1, white));
+    ro_batch_set_streaming(&stream, true);
+
+    bool ok = check(&stream, &subdata, false) && check(&stream, &subdata, true);
+
+    printf("bench_stream: %i rects, %i frames, %s\n", RECTS, frames, glGetString(GL_RENDERER));
+    printf("%-16s %10s %10s %10s %10s\n", "", "frame ms", "update ms", "orphaned", "kB/frame");
+    bench(&subdata, "subdata", frames, false);
+    bench(&stream, "stream", frames, false);
+    bench(&subdata, "subdata 1/8", frames, true);
+    bench(&stream, "stream 1/8", frames, true);
+
+    r_framebuffer_end();
+    ro_batch_kill(&subdata);
+    ro_batch_kill(&stream);
+    r_framebuffer_kill(&fb);
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+#include "rhc/rhc_impl.h"
+#include "u/prandom.h"
+#include "u/fill.h"
+
+//
+// compares u_fill_replace_row (SSE2 / NEON, if available) with a scalar version
+// on random rows of all lengths up to MAX_N (so all tails), from unaligned starts
+//
+
+#define MAX_N 67
+#define RUNS 20000
+
+
+static bool replace_row_scalar(uColor_s *row, int n, uColor_s from, uColor_s to) {
+    bool changed = false;
+    for (int i = 0; i < n; i++) {
+        if (!u_color_equals(row[i], from))
+            continue;
+        row[i] = to;
+        changed = true;
+    }
+    return changed;
+}
+
+// few different colors, so rows have matches and colors differ in single channels
+static uColor_s random_color() {
+    uColor_s c = {0, 0, 0, 0};
+    c.v[u_prand() % 4] = (uint8_t) (u_prand() % 3);
+    return c;
+}
+
+int main() {
+    u_pseed(42);
+    uColor_s buffer[MAX_N + 4];
+    uColor_s expected[MAX_N + 4];
+    int fails = 0;
+
+    for (int run = 0; run < RUNS; run++) {
+        int n = run % (MAX_N + 1);
+        int offset = (run / (MAX_N + 1)) % 4;
+        for (int i = 0; i < MAX_N + 4; i++)
+            buffer[i] = random_color();
+        memcpy(expected, buffer, sizeof buffer);
+
+        uColor_s from = random_color();
+        uColor_s to = random_color();
+
+        bool changed = u_fill_replace_row(buffer + offset, n, from, to);
+        bool expected_changed = replace_row_scalar(expected + offset, n, from, to);
+
+        // also checks, that the pixels around the row are untouched
+        if (changed != expected_changed || memcmp(buffer, expected, sizeof buffer) != 0) {
+            if (fails++ < 10)
+                printf("test_fill: replace_row failed for n=%i offset=%i\n", n, offset);
+        }
+    }
+
+    if (fails > 0) {
+        printf("test_fill: FAILED %i of %i runs\n", fails, RUNS);
+        return 1;
+    }
+    printf("test_fill: OK (%i runs)\n", RUNS);
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <string.h>
+#include "rhc/rhc_impl.h"
+#include "mathc/float.h"
+#include "e/definitions.h"
+#include "u/pose.h"
+#include "u/color.h"
+#include "r/r.h"
+
+//
+// renders a map with RoTilemap and the same map as rects with RoBatch and RoBatch2d
+// (as the canvas does without a tilemap) and compares the read back pixels.
+// The map contains empty cells, sheets that are not in the texture, a sheet id above RO_TILEMAP_MAX_SHEETS
+// and, in the slots pass, a remapped and an evicted sheet.
+// A last pass compares rotated, mirrored and uv cropped rects of RoBatch and RoBatch2d.
+// usage: test_tilemap, run it from the build dir (needs res/r/*.glsl)
+//
+
+#define COLS 16
+#define ROWS 12
+#define TILE 4          // pixels of a tile, rendered 1:1
+#define SHEET_TILES 2   // 2 x 2 tiles in a sheet
+#define SHEETS 3        // layers of the tiles texture
+#define PIXELS (ROWS * TILE * COLS * TILE * 4)
+
+
+static uColor_s map[ROWS][COLS];
+
+static void map_fill() {
+    static const int ids[] = {0, 1, 2, 3, 4, 200};
+    unsigned seed = 12345;
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            seed = seed * 1103515245 + 12345;
+            int id = ids[(seed >> 16) % 6];
+            int tile = (seed >> 8) % (SHEET_TILES * SHEET_TILES);
+            map[r][c] = (uColor_s) {0, 0, id, tile};
+        }
+    }
+}
+
+// sheets as layers, each texel unique
+static rTexture sheets_new() {
+    int size = SHEET_TILES * TILE;
+    static uColor_s pixels[SHEETS][SHEET_TILES * TILE][SHEET_TILES * TILE];
+    for (int s = 0; s < SHEETS; s++) {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++)
+                pixels[s][y][x] = (uColor_s) {20 + 60 * s, 10 + 30 * (y / TILE * SHEET_TILES + x / TILE),
+                                              3 * (y * size + x), 255};
+        }
+    }
+    return r_texture_new(size, size * SHEETS, 1, SHEETS, pixels);
+}
+
+// texture layer of a sheet id, or -1 if not rendered
+static int sheet_layer(int id, const int *opt_slots) {
+    if (!opt_slots)
+        return id >= 1 && id <= SHEETS ? id - 1 : -1;
+    return id >= 1 && id <= RO_TILEMAP_MAX_SHEETS ? opt_slots[id - 1] : -1;
+}
+
+static void render_tilemap(RoTilemap *self, const int *opt_slots, void *out_pixels) {
+    self->slots = opt_slots;
+    glClear(GL_COLOR_BUFFER_BIT);
+    ro_tilemap_render(self);
+    glReadPixels(0, 0, COLS * TILE, ROWS * TILE, GL_RGBA, GL_UNSIGNED_BYTE, out_pixels);
+}
+
+// sets the rect of both batches, uv_xy is the left top corner
+static void set_rect(RoBatch *batch, RoBatch2d *batch2d, int i, vec2 xy, vec2 size, float angle,
+                     vec2 uv_xy, vec2 uv_size, int layer) {
+    rRect_s *rect = &batch->rects[i];
+    rect->pose = u_pose_new_angle(xy.x, xy.y, size.x, size.y, angle);
+    rect->uv = mat4_eye();
+    u_pose_set(&rect->uv, uv_xy.x, uv_xy.y, uv_size.x, uv_size.y, 0);
+    rect->color = (vec4) {{1, 1, 1, 1}};
+    rect->sprite = (vec2) {{0, layer}};
+
+    rRect2d_s *rect2d = &batch2d->rects[i];
+    rect2d->xy = xy;
+    rect2d->size = size;
+    rect2d->uv_xy = uv_xy;
+    rect2d->uv_size = uv_size;
+    rect2d->angle = angle;
+    rect2d->color = (ucvec4) {{255, 255, 255, 255}};
+    rect2d->sprite.x = 0;
+    rect2d->sprite.y = layer;
+}
+
+static void render_batches(RoBatch *batch, RoBatch2d *batch2d, int n, void *out_pixels, void *out_pixels2d) {
+    ro_batch_update_sub(batch, 0, n);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ro_batch_render_sub(batch, n);
+    glReadPixels(0, 0, COLS * TILE, ROWS * TILE, GL_RGBA, GL_UNSIGNED_BYTE, out_pixels);
+
+    ro_batch2d_update_sub(batch2d, 0, n);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ro_batch2d_render_sub(batch2d, n);
+    glReadPixels(0, 0, COLS * TILE, ROWS * TILE, GL_RGBA, GL_UNSIGNED_BYTE, out_pixels2d);
+}
+
+// a rect for each rendered cell
+static int set_map_rects(RoBatch *batch, RoBatch2d *batch2d, const int *opt_slots) {
+    int n = 0;
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            int layer = sheet_layer(map[r][c].b, opt_slots);
+            if (layer < 0)
+                continue;
+            int tile = map[r][c].a;
+            set_rect(batch, batch2d, n++,
+                     (vec2) {{-1 + (c + 0.5f) * 2 / COLS, 1 - (r + 0.5f) * 2 / ROWS}},
+                     (vec2) {{2.0f / COLS, 2.0f / ROWS}}, 0,
+                     (vec2) {{(float) (tile % SHEET_TILES) / SHEET_TILES, (float) (tile / SHEET_TILES) / SHEET_TILES}},
+                     (vec2) {{1.0f / SHEET_TILES, 1.0f / SHEET_TILES}}, layer);
+        }
+    }
+    return n;
+}
+
+// returns the number of different pixels
+static int compare(const unsigned char *a, const unsigned char *b, int *out_drawn) {
+    int bad = 0;
+    *out_drawn = 0;
+    for (int i = 0; i < PIXELS; i += 4) {
+        if (memcmp(a + i, b + i, 4) != 0)
+            bad++;
+        if (b[i + 3] != 0)
+            (*out_drawn)++;
+    }
+    return bad;
+}
+
+static bool check_map(RoTilemap *tilemap, RoBatch *batch, RoBatch2d *batch2d, const int *opt_slots,
+                      const char *name) {
+    static unsigned char a[PIXELS], b[PIXELS], b2d[PIXELS];
+    render_tilemap(tilemap, opt_slots, a);
+    render_batches(batch, batch2d, set_map_rects(batch, batch2d, opt_slots), b, b2d);
+    int drawn, drawn2d;
+    int bad = compare(a, b, &drawn);
+    int bad2d = compare(a, b2d, &drawn2d);
+    printf("test_tilemap: %-8s %i (batch) and %i (batch2d) of %i pixels differ, %i drawn\n",
+           name, bad, bad2d, PIXELS / 4, drawn);
+    return bad == 0 && bad2d == 0 && drawn > 0;
+}
+
+// rotated, mirrored and uv cropped rects
+static bool check_rects(RoBatch *batch, RoBatch2d *batch2d) {
+    static unsigned char b[PIXELS], b2d[PIXELS];
+    int n = 0;
+    for (int i = 0; i < 12; i++) {
+        float x = -0.7f + 0.45f * (i % 4), y = 0.6f - 0.6f * (i / 4);
+        vec2 size = {{(i % 3 == 1 ? -0.3f : 0.3f), (i % 5 == 2 ? -0.4f : 0.4f)}};
+        set_rect(batch, batch2d, n++, (vec2) {{x, y}}, size, i * 0.4f,
+                 (vec2) {{0.125f * (i % 4), 0.125f * (i % 3)}}, (vec2) {{0.5f, 0.375f}}, i % SHEETS);
+    }
+    render_batches(batch, batch2d, n, b, b2d);
+    int drawn;
+    int bad = compare(b, b2d, &drawn);
+    printf("test_tilemap: rects    %i of %i pixels differ, %i drawn\n", bad, PIXELS / 4, drawn);
+    return bad == 0 && drawn > 0;
+}
+
+int main(int argc, char **argv) {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        log_error("test_tilemap: SDL_Init failed: %s", SDL_GetError());
+        return 1;
+    }
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, E_GL_MAJOR_VERSION);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, E_GL_MINOR_VERSION);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, E_GL_PROFILE);
+    SDL_Window *window = SDL_CreateWindow("test_tilemap", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                          COLS * TILE, ROWS * TILE, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    SDL_GLContext context = window ? SDL_GL_CreateContext(window) : NULL;
+    if (!context) {
+        log_error("test_tilemap: no gl context: %s", SDL_GetError());
+        return 1;
+    }
+#ifdef OPTION_GLEW
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        log_error("test_tilemap: glewInit failed");
+        return 1;
+    }
+#endif
+    r_render_init(window);
+
+    rFramebuffer fb = r_framebuffer_new(COLS * TILE, ROWS * TILE);
+    r_framebuffer_begin(fb);
+    glClearColor(0, 0, 0, 0);
+
+    map_fill();
+    mat4 vp = mat4_eye();
+    RoTilemap tilemap = ro_tilemap_new(COLS, ROWS, (ivec2) {{SHEET_TILES, SHEET_TILES}}, &vp.m00, sheets_new());
+    tilemap.pose = u_pose_new(0, 0, 2, 2);
+    ro_tilemap_set(&tilemap, map);
+    RoBatch batch = ro_batch_new(COLS * ROWS, &vp.m00, sheets_new());
+    RoBatch2d batch2d = ro_batch2d_new(COLS * ROWS, &vp.m00, sheets_new());
+
+    // sheet 1 -> layer 2, sheet 2 evicted, sheet 3 -> layer 0, sheet 4 -> layer 1
+    int slots[RO_TILEMAP_MAX_SHEETS];
+    for (int i = 0; i < RO_TILEMAP_MAX_SHEETS; i++)
+        slots[i] = -1;
+    slots[0] = 2;
+    slots[2] = 0;
+    slots[3] = 1;
+
+    bool ok = check_map(&tilemap, &batch, &batch2d, NULL, "layers");
+    ok = check_map(&tilemap, &batch, &batch2d, slots, "slots") && ok;
+    ok = check_rects(&batch, &batch2d) && ok;
+
+    r_framebuffer_end();
+    ro_tilemap_kill(&tilemap);
+    ro_batch_kill(&batch);
+    ro_batch2d_kill(&batch2d);
+    r_framebuffer_kill(&fb);
+    SDL_GL_DeleteContext(context);
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return ok ? 0 : 1;
+}